@@ -6,9 +6,136 @@ This queue will simulate a CPU scheduling system, managing a collection of CPU j
 
 #include <iostream>
 #include <string>
+#include <algorithm>
+#include <set>
+#include <map>
+#include <climits>
+#include <new>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 using namespace std;
 
+// Heap allocation counter reported by the benchmark mode. Every allocation in the program goes through these operators
+// (kept out of line so the compiler does not pair the inlined malloc/free with unrelated new/delete expressions).
+long long allocationCount = 0;
+__attribute__((noinline)) void* operator new(size_t bytes) {
+    allocationCount++;
+    void* memory = malloc(bytes > 0 ? bytes : 1);
+    if (!memory) {
+        throw bad_alloc();
+    }
+    return memory;
+}
+__attribute__((noinline)) void operator delete(void* memory) noexcept {
+    free(memory);
+}
+__attribute__((noinline)) void operator delete(void* memory, size_t) noexcept { // Sized deletes go through the same hook
+    operator delete(memory);
+}
+
+// Output buffer that collects text in one reusable block and writes it to the stream in large chunks,
+// instead of flushing on every line the way endl does.
+class OutputBuffer {
+    public:
+        static const int CAPACITY = 1 << 16; // Bytes held before the buffer is written out
+        char* buffer; // Pending output
+        int length; // Number of pending bytes
+        ostream* output; // Stream the buffer is written to
+        OutputBuffer(ostream& output); // Constructor
+        ~OutputBuffer(); // Destructor (writes anything still pending)
+        void flush(); // Writes pending output to the stream
+        void write(const char* text, int n); // Appends n bytes
+        OutputBuffer& operator<<(const char* text); // Appends a C string
+        OutputBuffer& operator<<(const string& text); // Appends a string
+        OutputBuffer& operator<<(char c); // Appends one character
+        OutputBuffer& operator<<(int value); // Appends an integer in decimal
+        OutputBuffer& operator<<(long long value); // Appends an integer in decimal
+        OutputBuffer& operator<<(double value); // Appends a floating point value formatted like cout
+};
+OutputBuffer::OutputBuffer(ostream& output) { // Constructor
+    (*this).output = &output;
+    (*this).length = 0;
+    buffer = new char[CAPACITY];
+}
+OutputBuffer::~OutputBuffer() { // Destructor (writes anything still pending)
+    flush();
+    delete[] buffer;
+}
+void OutputBuffer::flush() { // Writes pending output to the stream
+    if (length > 0) {
+        output->write(buffer, length);
+        length = 0;
+    }
+    output->flush();
+}
+void OutputBuffer::write(const char* text, int n) { // Appends n bytes
+    if (length + n > CAPACITY) { // Make room by writing out what is pending
+        output->write(buffer, length);
+        length = 0;
+        if (n > CAPACITY) { // Too large to buffer, so write it directly
+            output->write(text, n);
+            return;
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        buffer[length + i] = text[i];
+    }
+    length += n;
+}
+OutputBuffer& OutputBuffer::operator<<(const char* text) { // Appends a C string
+    int n = 0;
+    while (text[n] != '\0') {
+        n++;
+    }
+    write(text, n);
+    return *this;
+}
+OutputBuffer& OutputBuffer::operator<<(const string& text) { // Appends a string
+    write(text.data(), (int)text.size());
+    return *this;
+}
+OutputBuffer& OutputBuffer::operator<<(char c) { // Appends one character
+    write(&c, 1);
+    return *this;
+}
+OutputBuffer& OutputBuffer::operator<<(int value) { // Appends an integer in decimal
+    return *this << (long long)value;
+}
+OutputBuffer& OutputBuffer::operator<<(long long value) { // Appends an integer in decimal
+    char digits[24];
+    int n = 0;
+    unsigned long long magnitude = value < 0 ? 0ull - (unsigned long long)value : (unsigned long long)value;
+    do { // Digits come out in reverse order
+        digits[n++] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude > 0);
+    if (value < 0) {
+        digits[n++] = '-';
+    }
+    char text[24];
+    for (int i = 0; i < n; i++) {
+        text[i] = digits[n - 1 - i];
+    }
+    write(text, n);
+    return *this;
+}
+OutputBuffer& OutputBuffer::operator<<(double value) { // Appends a floating point value formatted like cout
+    char text[32];
+    int n = snprintf(text, sizeof(text), "%g", value);
+    write(text, n);
+    return *this;
+}
+
 // Class for holding each individual CPU task.
 class CPUJob {
     public:
@@ -22,6 +149,7 @@ class CPUJob {
         CPUJob(CPUJob& copy); // Copy constructor
         ~CPUJob(); // Destructor
         void display(); // Display method
+        void display(OutputBuffer& out); // Display method that writes to an output buffer
 };
 CPUJob::CPUJob() {} // Default constructor
 CPUJob::CPUJob(int job_id, int priority, int job_type, int cpu_time_consumed, int memory_consumed) { // Parameterized constructor
@@ -42,395 +170,2339 @@ CPUJob::~CPUJob() {} // Destructor
 void CPUJob::display() { // Display method
     cout << "Job ID: " << job_id << ", Priority: " << priority << ", Job Type: " << job_type << ", CPU Time Consumed: " << cpu_time_consumed << ", Memory Consumed: " << memory_consumed << endl;
 }
+void CPUJob::display(OutputBuffer& out) { // Display method that writes to an output buffer
+    out << "Job ID: " << job_id << ", Priority: " << priority << ", Job Type: " << job_type << ", CPU Time Consumed: " << cpu_time_consumed << ", Memory Consumed: " << memory_consumed << '\n';
+}
 
 // Queue data structure (FiFo).
+// Nodes are kept in an implicit treap: a randomized balanced binary tree whose in-order traversal is the queue order.
+// Each node stores the size of its subtree, so positions can be found and changed in O(log n) without an index array.
 template <class DT>
 class Queue {
     public:
         DT JobPointer; // Pointer to a CPUJob
-        Queue<DT>* next; // Pointer to the next node in the queue
+        Queue<DT>* left; // Subtree of nodes ahead of this one
+        Queue<DT>* right; // Subtree of nodes behind this one
+        Queue<DT>* parent; // Parent node in the tree (nullptr for the root)
+        int subtreeSize; // Number of nodes in the subtree rooted here
+        unsigned int heapPriority; // Random priority that keeps the tree balanced (parents are never lower than children)
         Queue(){} // Default constructor
-        Queue(DT CPUJob); // Create a new queue object with a CPUJob object
+        Queue(DT CPUJob, unsigned int heapPriority); // Create a new queue object with a CPUJob object
 };
 template <class DT>
-Queue<DT>::Queue(DT CPUJob) { // Create a new queue object with a given CPUJob object
+Queue<DT>::Queue(DT CPUJob, unsigned int heapPriority) { // Create a new queue object with a given CPUJob object
     JobPointer = CPUJob;
+    left = nullptr;
+    right = nullptr;
+    parent = nullptr;
+    subtreeSize = 1;
+    (*this).heapPriority = heapPriority;
+}
+
+// Slab allocator with free-list reuse. Objects are carved out of large slabs, and released objects are
+// threaded onto a free list so steady-state allocate/release never calls the system allocator.
+template <class T>
+class SlabPool {
+    public:
+        static const int SLAB_OBJECTS = 256; // Number of objects carved out of each slab
+        char** slabs; // Array of allocated slabs
+        int slabCount; // Number of slabs in use
+        int slabCapacity; // Number of slots in the slabs array
+        int nextUnused; // Index of the next never-used object within the newest slab
+        size_t slotSize; // Bytes per object slot (large enough to also hold a free-list link)
+        void* freeList; // Singly linked list of released slots
+        SlabPool(); // Default constructor
+        ~SlabPool(); // Destructor, frees every slab at once
+        void* allocate(); // Returns raw memory for one object (construct it with placement new)
+        void release(T* object); // Destroys an object and returns its slot to the free list
+};
+template <class T>
+SlabPool<T>::SlabPool() { // Default constructor
+    size_t align = alignof(T) > alignof(void*) ? alignof(T) : alignof(void*);
+    size_t bytes = sizeof(T) > sizeof(void*) ? sizeof(T) : sizeof(void*);
+    (*this).slotSize = (bytes + align - 1) / align * align; // Round up so every slot stays aligned
+    (*this).slabs = nullptr;
+    (*this).slabCount = 0;
+    (*this).slabCapacity = 0;
+    (*this).nextUnused = SLAB_OBJECTS; // Forces a slab to be allocated on first use
+    (*this).freeList = nullptr;
+}
+template <class T>
+SlabPool<T>::~SlabPool() { // Destructor, frees every slab at once
+    for (int i = 0; i < slabCount; i++) {
+        ::operator delete(slabs[i]);
+    }
+    delete[] slabs;
+}
+template <class T>
+void* SlabPool<T>::allocate() { // Returns raw memory for one object (construct it with placement new)
+    if (freeList) { // Reuse a released slot first
+        void* slot = freeList;
+        freeList = *(void**)slot;
+        return slot;
+    }
+    if (nextUnused == SLAB_OBJECTS) { // Current slab is used up, so allocate another one
+        if (slabCount == slabCapacity) { // Double the slab array when full
+            int newCapacity = slabCapacity == 0 ? 4 : slabCapacity * 2;
+            char** newSlabs = new char*[newCapacity];
+            for (int i = 0; i < slabCount; i++) {
+                newSlabs[i] = slabs[i];
+            }
+            delete[] slabs;
+            slabs = newSlabs;
+            slabCapacity = newCapacity;
+        }
+        slabs[slabCount++] = (char*)::operator new(slotSize * SLAB_OBJECTS);
+        nextUnused = 0;
+    }
+    return slabs[slabCount - 1] + slotSize * (nextUnused++);
+}
+template <class T>
+void SlabPool<T>::release(T* object) { // Destroys an object and returns its slot to the free list
+    if (!object) {
+        return;
+    }
+    object->~T();
+    *(void**)object = freeList;
+    freeList = object;
+}
+
+// Hash index from job_id to the queue node holding that job (open addressing with linear probing).
+// Each slot keeps the key next to the node pointer, so a lookup usually touches a single cache line.
+template <class NodeT>
+class JobIndex {
+    public:
+        class Entry {
+            public:
+                int key; // job_id stored in this slot
+                NodeT* node; // Node stored in this slot (nullptr = empty, tombstone() = deleted)
+        };
+        Entry* entries; // Hash table slots
+        int capacity; // Number of slots (always a power of two)
+        int used; // Number of slots that are full or deleted
+        int count; // Number of live entries
+        JobIndex(); // Default constructor
+        ~JobIndex(); // Destructor
+        NodeT* find(int job_id); // Returns the node for a job_id, or nullptr
+        bool insert(int job_id, NodeT* node); // Adds an entry, returns false (and changes nothing) if job_id is already present
+        void erase(int job_id); // Removes an entry if present
+        void reserve(int entries); // Grows the table so it can hold this many entries without rehashing
+        void rehash(int newCapacity); // Moves every live entry into a table of newCapacity slots
+        void prefetch(int job_id) { __builtin_prefetch(&entries[slotOf(job_id)]); } // Starts loading a job_id's slot into cache
+        int slotOf(int job_id); // First probe position of a job_id
+        static NodeT* tombstone() { return (NodeT*)(&tombstoneMarker); }
+        static char tombstoneMarker; // Address used to mark deleted slots
+};
+template <class NodeT>
+char JobIndex<NodeT>::tombstoneMarker;
+template <class NodeT>
+JobIndex<NodeT>::JobIndex() { // Default constructor
+    (*this).capacity = 16;
+    (*this).used = 0;
+    (*this).count = 0;
+    entries = new Entry[capacity];
+    for (int i = 0; i < capacity; i++) {
+        entries[i].node = nullptr;
+    }
+}
+template <class NodeT>
+JobIndex<NodeT>::~JobIndex() { // Destructor
+    delete[] entries;
+}
+template <class NodeT>
+int JobIndex<NodeT>::slotOf(int job_id) { // First probe position of a job_id
+    unsigned int h = (unsigned int)job_id * 2654435769u; // Fibonacci hashing spreads sequential ids
+    return (int)(h & (unsigned int)(capacity - 1));
+}
+template <class NodeT>
+NodeT* JobIndex<NodeT>::find(int job_id) { // Returns the node for a job_id, or nullptr
+    for (int i = slotOf(job_id); entries[i].node != nullptr; i = (i + 1) & (capacity - 1)) {
+        if (entries[i].key == job_id && entries[i].node != tombstone()) {
+            return entries[i].node;
+        }
+    }
+    return nullptr;
+}
+template <class NodeT>
+bool JobIndex<NodeT>::insert(int job_id, NodeT* node) { // Adds an entry, returns false if job_id is already present
+    if ((long long)(used + 1) * 4 > (long long)capacity * 3) { // Keep the table at most three quarters full
+        rehash(count * 2 > capacity ? capacity * 2 : capacity);
+    }
+    int target = -1; // First deleted slot seen, reused if the key is absent
+    int i = slotOf(job_id);
+    for (; entries[i].node != nullptr; i = (i + 1) & (capacity - 1)) {
+        if (entries[i].node == tombstone()) {
+            if (target == -1) {
+                target = i;
+            }
+        }
+        else if (entries[i].key == job_id) {
+            return false;
+        }
+    }
+    if (target == -1) { // Use the empty slot that ended the probe
+        target = i;
+        used++;
+    }
+    entries[target].key = job_id;
+    entries[target].node = node;
+    count++;
+    return true;
+}
+template <class NodeT>
+void JobIndex<NodeT>::erase(int job_id) { // Removes an entry if present
+    for (int i = slotOf(job_id); entries[i].node != nullptr; i = (i + 1) & (capacity - 1)) {
+        if (entries[i].key == job_id && entries[i].node != tombstone()) {
+            entries[i].node = tombstone();
+            count--;
+            return;
+        }
+    }
+}
+template <class NodeT>
+void JobIndex<NodeT>::reserve(int wanted) { // Grows the table so it can hold this many entries without rehashing
+    int newCapacity = capacity;
+    while ((long long)(count + wanted) * 4 > (long long)newCapacity * 3) {
+        newCapacity *= 2;
+    }
+    if (newCapacity != capacity) {
+        rehash(newCapacity);
+    }
+}
+template <class NodeT>
+void JobIndex<NodeT>::rehash(int newCapacity) { // Moves every live entry into a table of newCapacity slots
+    Entry* oldEntries = entries;
+    int oldCapacity = capacity;
+    capacity = newCapacity;
+    entries = new Entry[capacity];
+    for (int i = 0; i < capacity; i++) {
+        entries[i].node = nullptr;
+    }
+    used = 0;
+    count = 0;
+    for (int i = 0; i < oldCapacity; i++) { // Re-insert live entries, dropping tombstones
+        if (oldEntries[i].node != nullptr && oldEntries[i].node != tombstone()) {
+            insert(oldEntries[i].key, oldEntries[i].node);
+        }
+    }
+    delete[] oldEntries;
+}
+
+// Word-at-a-time FNV-1a style hash used to checksum log records and snapshots.
+unsigned long long checksumWords(const unsigned int* words, long long count, unsigned long long hash = 14695981039346656037ull) {
+    for (long long i = 0; i < count; i++) {
+        hash = (hash ^ words[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+// Append-only write-ahead log of NovelQueue operations with group commit.
+// The file starts with a 16 byte header (magic and generation) followed by fixed-size records:
+//     checksum (4 bytes), operation (4 bytes), five 32-bit arguments.
+// Records are collected in memory and written with a single write and fdatasync per group, so durability costs one
+// sync per batch of commands rather than one per operation. A torn record at the end of the file is dropped on recovery.
+class QueueLog {
+    public:
+        enum Operation { ENQUEUE = 1, DEQUEUE, REMOVE, MODIFY, CHANGE, PROMOTE, REORDER };
+        static const int RECORD_WORDS = 7; // Words per record (checksum, operation, five arguments)
+        static const int HEADER_BYTES = 16; // Magic (8 bytes) and generation (8 bytes)
+        static const int GROUP_RECORDS = 4096; // Records buffered before a commit is forced
+        string directory; // Directory holding queue.log and queue.snapshot
+        int fd; // Descriptor of the open log file
+        unsigned long long generation; // Snapshot generation this log continues from
+        unsigned int* pending; // Records waiting for the next commit
+        int pendingCount; // Number of records in pending
+        long long recordsSinceSnapshot; // Records appended since the last snapshot (used to trigger the next one)
+        QueueLog(const string& directory); // Opens (or creates) the log in a directory
+        ~QueueLog(); // Commits anything pending and closes the log
+        string logPath(); // Path of the log file
+        string snapshotPath(); // Path of the snapshot file
+        void append(int operation, int a0 = 0, int a1 = 0, int a2 = 0, int a3 = 0, int a4 = 0); // Buffers one record
+        void commit(); // Writes buffered records and syncs them to disk
+        void reset(unsigned long long newGeneration); // Empties the log and starts a new generation (after a snapshot)
+};
+QueueLog::QueueLog(const string& directory) { // Opens (or creates) the log in a directory
+    (*this).directory = directory;
+    (*this).generation = 0;
+    (*this).pendingCount = 0;
+    (*this).recordsSinceSnapshot = 0;
+    pending = new unsigned int[GROUP_RECORDS * RECORD_WORDS];
+    mkdir(directory.c_str(), 0755); // Fine if it already exists
+    fd = open(logPath().c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        cerr << "Cannot open " << logPath() << endl;
+        exit(1);
+    }
+    char header[HEADER_BYTES];
+    if (pread(fd, header, HEADER_BYTES, 0) == HEADER_BYTES && memcmp(header, "NQLOG001", 8) == 0) {
+        memcpy(&generation, header + 8, 8);
+    }
+    else { // New or unreadable log
+        reset(0);
+    }
+}
+QueueLog::~QueueLog() { // Commits anything pending and closes the log
+    commit();
+    close(fd);
+    delete[] pending;
+}
+string QueueLog::logPath() { // Path of the log file
+    return directory + "/queue.log";
+}
+string QueueLog::snapshotPath() { // Path of the snapshot file
+    return directory + "/queue.snapshot";
+}
+void QueueLog::append(int operation, int a0, int a1, int a2, int a3, int a4) { // Buffers one record
+    if (pendingCount == GROUP_RECORDS) {
+        commit();
+    }
+    unsigned int* record = pending + pendingCount * RECORD_WORDS;
+    record[1] = (unsigned int)operation;
+    record[2] = (unsigned int)a0;
+    record[3] = (unsigned int)a1;
+    record[4] = (unsigned int)a2;
+    record[5] = (unsigned int)a3;
+    record[6] = (unsigned int)a4;
+    record[0] = (unsigned int)checksumWords(record + 1, RECORD_WORDS - 1);
+    pendingCount++;
+    recordsSinceSnapshot++;
+}
+void QueueLog::commit() { // Writes buffered records and syncs them to disk
+    if (pendingCount == 0) {
+        return;
+    }
+    const char* data = (const char*)pending;
+    long long bytes = (long long)pendingCount * RECORD_WORDS * 4;
+    lseek(fd, 0, SEEK_END);
+    while (bytes > 0) { // write may be partial
+        ssize_t written = write(fd, data, bytes);
+        if (written < 0) {
+            cerr << "Write to " << logPath() << " failed" << endl;
+            exit(1);
+        }
+        data += written;
+        bytes -= written;
+    }
+    fdatasync(fd);
+    pendingCount = 0;
+}
+void QueueLog::reset(unsigned long long newGeneration) { // Empties the log and starts a new generation
+    pendingCount = 0;
+    generation = newGeneration;
+    char header[HEADER_BYTES];
+    memcpy(header, "NQLOG001", 8);
+    memcpy(header + 8, &generation, 8);
+    if (ftruncate(fd, 0) != 0 || pwrite(fd, header, HEADER_BYTES, 0) != HEADER_BYTES) {
+        cerr << "Cannot reset " << logPath() << endl;
+        exit(1);
+    }
+    fdatasync(fd);
+    recordsSinceSnapshot = 0;
+}
+
+// Ordered secondary indexes over the CPUJob attributes, so a query only walks the jobs it returns.
+// Fields are numbered as in NovelQueue::change: 1 = priority, 2 = job_type, 3 = cpu_time_consumed, 4 = memory_consumed.
+// Every key ends with the job_id, so jobs with equal values come out in job_id order.
+class QueryIndex {
+    public:
+        set<unsigned long long> byField[5]; // (value, job_id) keys for each field
+        map<int, int> counts[5]; // value -> number of jobs holding it, for each field
+        set<pair<unsigned long long, unsigned int> > composite[2][5]; // [equality field - 1][range field]: ((priority or job_type, other field), job_id) keys
+        static int fieldValue(CPUJob* job, int field); // Value of one field of a job
+        static unsigned int bias(int value); // Maps an int onto an unsigned int with the same order
+        static unsigned long long pack(int high, int low); // Packs two ints into a key ordered by high, then low
+        void add(CPUJob* job); // Indexes a job
+        void remove(CPUJob* job); // Removes a job from every index (must be called before its fields change)
+        template <class Visitor>
+        int range(int field, int low, int high, Visitor visit); // Calls visit(job_id) for jobs with low <= field <= high, in ascending order
+        template <class Visitor>
+        int top(int field, int k, Visitor visit); // Calls visit(job_id) for the k jobs with the largest field, largest first
+        template <class Visitor>
+        int rangeWhere(int equalField, int equalValue, int rangeField, int low, int high, Visitor visit); // Range over rangeField among jobs whose equalField == equalValue (-1 if that pair is not indexed)
+        template <class Visitor>
+        int groupCount(int field, Visitor visit); // Calls visit(value, count) for every distinct value of a field, in ascending order
+};
+int QueryIndex::fieldValue(CPUJob* job, int field) { // Value of one field of a job
+    switch (field) {
+        case 1: return job->priority;
+        case 2: return job->job_type;
+        case 3: return job->cpu_time_consumed;
+        default: return job->memory_consumed;
+    }
+}
+unsigned int QueryIndex::bias(int value) { // Flipping the sign bit keeps negative values ahead of positive ones
+    return (unsigned int)value ^ 0x80000000u;
+}
+unsigned long long QueryIndex::pack(int high, int low) { // Packs two ints into a key ordered by high, then low
+    return ((unsigned long long)bias(high) << 32) | bias(low);
+}
+void QueryIndex::add(CPUJob* job) { // Indexes a job
+    for (int field = 1; field <= 4; field++) {
+        int value = fieldValue(job, field);
+        byField[field].insert(pack(value, job->job_id));
+        counts[field][value]++;
+    }
+    for (int e = 1; e <= 2; e++) { // Conjunctive queries filter on priority or job_type, then take a range over any other field
+        for (int r = 1; r <= 4; r++) {
+            if (r != e) {
+                composite[e - 1][r].insert(make_pair(pack(fieldValue(job, e), fieldValue(job, r)), bias(job->job_id)));
+            }
+        }
+    }
+}
+void QueryIndex::remove(CPUJob* job) { // Removes a job from every index
+    for (int field = 1; field <= 4; field++) {
+        int value = fieldValue(job, field);
+        byField[field].erase(pack(value, job->job_id));
+        map<int, int>::iterator it = counts[field].find(value);
+        if (--it->second == 0) { // Drop empty groups so group-by stays proportional to the number of groups
+            counts[field].erase(it);
+        }
+    }
+    for (int e = 1; e <= 2; e++) {
+        for (int r = 1; r <= 4; r++) {
+            if (r != e) {
+                composite[e - 1][r].erase(make_pair(pack(fieldValue(job, e), fieldValue(job, r)), bias(job->job_id)));
+            }
+        }
+    }
+}
+template <class Visitor>
+int QueryIndex::range(int field, int low, int high, Visitor visit) { // Jobs with low <= field <= high
+    if (field < 1 || field > 4 || low > high) {
+        return 0;
+    }
+    int found = 0;
+    set<unsigned long long>::iterator end = byField[field].upper_bound(pack(high, INT_MAX));
+    for (set<unsigned long long>::iterator it = byField[field].lower_bound(pack(low, INT_MIN)); it != end; ++it) {
+        visit((int)((unsigned int)*it ^ 0x80000000u)); // The low half of the key is the job_id
+        found++;
+    }
+    return found;
+}
+template <class Visitor>
+int QueryIndex::top(int field, int k, Visitor visit) { // The k jobs with the largest field, largest first (ties go to the larger job_id)
+    if (field < 1 || field > 4) {
+        return 0;
+    }
+    int found = 0;
+    for (set<unsigned long long>::reverse_iterator it = byField[field].rbegin(); it != byField[field].rend() && found < k; ++it) {
+        visit((int)((unsigned int)*it ^ 0x80000000u));
+        found++;
+    }
+    return found;
+}
+template <class Visitor>
+int QueryIndex::rangeWhere(int equalField, int equalValue, int rangeField, int low, int high, Visitor visit) { // Range over rangeField among jobs whose equalField == equalValue
+    if (equalField < 1 || equalField > 2 || rangeField < 1 || rangeField > 4 || rangeField == equalField) { // Only the indexed combinations
+        return -1;
+    }
+    if (low > high) {
+        return 0;
+    }
+    int found = 0;
+    set<pair<unsigned long long, unsigned int> >& keys = composite[equalField - 1][rangeField];
+    set<pair<unsigned long long, unsigned int> >::iterator end = keys.upper_bound(make_pair(pack(equalValue, high), UINT_MAX));
+    for (set<pair<unsigned long long, unsigned int> >::iterator it = keys.lower_bound(make_pair(pack(equalValue, low), 0u)); it != end; ++it) {
+        visit((int)(it->second ^ 0x80000000u));
+        found++;
+    }
+    return found;
+}
+template <class Visitor>
+int QueryIndex::groupCount(int field, Visitor visit) { // Every distinct value of a field with the number of jobs holding it
+    if (field < 1 || field > 4) {
+        return 0;
+    }
+    for (map<int, int>::iterator it = counts[field].begin(); it != counts[field].end(); ++it) {
+        visit(it->first, it->second);
+    }
+    return (int)counts[field].size();
 }
 
 // Class for storing and maintaining the CPUJob queue (FiFo).
+// Positions are backed by an implicit treap, so enqueue, dequeue, promote, position lookups and removal from
+// the middle are all O(log n). A hash index finds a job's node from its job_id in O(1).
 template <class DT>
 class NovelQueue {
     public:
-        Queue<DT>* front; // Pointer to the front of the queue
-        Queue<DT>** NodePtrs; // Array of queue node pointers
+        Queue<DT>* root; // Root of the implicit treap holding the queue nodes
+        JobIndex<Queue<DT> > index; // job_id -> node
         int size; // Number of elements
+        unsigned int seed; // State of the random generator for node priorities
+        SlabPool<CPUJob> jobPool; // Storage for the CPUJob objects held by this queue
+        SlabPool<Queue<DT> > nodePool; // Storage for the queue nodes
+        QueueLog* journal; // Write-ahead log that records every change (nullptr when the queue is not persisted)
+        QueryIndex* queries; // Secondary indexes, built by the first query and kept up to date from then on (nullptr until then)
         NovelQueue(); // Default constructor
         ~NovelQueue(); // Destructor
         int enqueue(CPUJob* newJob); // Method to add elements to the queue
+        int enqueueBatch(CPUJob** newJobs, int n, bool* added); // Adds several jobs at once in O(n), marking which ones were added
         CPUJob* dequeue(); // Method to remove elements from the queue
+        CPUJob* remove(int job_id); // Removes a job from anywhere in the queue and returns it (nullptr if not found)
         int modify(int job_id, int new_priority, int new_job_type, int new_cpu_time_consumed, int new_memory_consumed); // Method to modify the first CPUJob object in the queue
         int change(int job_id, int field_index, int new_value); // Change job values
         int promote(int job_id, int positions); // Move CPUJob higher in the queue based on the given positions value
         void reorder(int attribute_index); // Reorders the queue
         void display(); // Display method
+        void display(OutputBuffer& out); // Display method that writes to an output buffer
         int count(); // Returns number of elements in queue
         void listJobs(); // Prints jobs within queue
-        int binarySearch(int key); // Performs a binary search on the NodePtrs and returns the element of the key
-        int incrementalSearch(int key); // Performs an incremental search on the NodePtrs and returns the element of the key
+        CPUJob* jobAt(int position); // Returns the job at a position in the queue (0 is the front)
+        int position(int job_id); // Returns the position of a job in the queue, or -1 if it is not queued
+        template <class Visitor>
+        void forEach(Visitor visit); // Calls visit(job) for every job in queue order
+        CPUJob* find(int job_id); // Returns the queued job with a job_id (nullptr if not found)
+        QueryIndex* queryIndex(); // Secondary indexes over the queued jobs, built on first use
+        template <class Visitor>
+        int queryRange(int field, int low, int high, Visitor visit); // Calls visit(job) for jobs with low <= field <= high, ordered by field then job_id
+        template <class Visitor>
+        int queryTop(int field, int k, Visitor visit); // Calls visit(job) for the k jobs with the largest field, largest first
+        template <class Visitor>
+        int queryRangeWhere(int equalField, int equalValue, int rangeField, int low, int high, Visitor visit); // Range query among jobs whose equalField == equalValue
+        template <class Visitor>
+        int queryGroupCount(int field, Visitor visit); // Calls visit(value, count) for each distinct value of a field
+        CPUJob* createJob(int job_id, int priority, int job_type, int cpu_time_consumed, int memory_consumed); // Allocates a CPUJob from the job pool
+        void releaseJob(CPUJob* job); // Returns a CPUJob (e.g. one that was dequeued) to the job pool
+        unsigned int nextPriority(); // Random heap priority for a new node
+        int sizeOf(Queue<DT>* node); // Subtree size (0 for nullptr)
+        void update(Queue<DT>* node); // Recomputes a node's subtree size and re-parents its children
+        Queue<DT>* merge(Queue<DT>* a, Queue<DT>* b); // Joins two treaps, all of a ahead of all of b
+        void split(Queue<DT>* node, int k, Queue<DT>*& a, Queue<DT>*& b); // Splits a treap into its first k nodes and the rest
+        Queue<DT>* build(Queue<DT>** nodes, int n); // Builds a treap from nodes already in queue order in O(n)
+        int rankOf(Queue<DT>* node); // Position of a node in the queue
 };
 template <class DT>
 NovelQueue<DT>::NovelQueue() { // Default constructor
-    front = new Queue<DT>();
+    root = nullptr; // Queue starts empty
     size = 0; // initialized at 0, as queue starts empty
-    NodePtrs = new Queue<DT>*[size];
+    seed = 2463534242u;
+    journal = nullptr;
+    queries = nullptr;
 }
 template <class DT>
-NovelQueue<DT>::~NovelQueue() { // Destructor
-    delete front;
-    delete[] NodePtrs;
+NovelQueue<DT>::~NovelQueue() { // Destructor (the pools free every remaining job and node)
+    delete queries;
 }
 template <class DT>
-int NovelQueue<DT>::enqueue(CPUJob* newJob) { // Enqueue method
-    Queue<DT>** newArray = new Queue<DT>*[size + 1];  // Increase array size by 1
-    for (int i = 0; i < size; i++) { // Copy over to newArray
-        if (NodePtrs[i]->JobPointer->job_id == newJob->job_id) { // Check to see if newJob is already within NodePtrs
-            return -1; // Return -1 so that we can show job is already within queue
+CPUJob* NovelQueue<DT>::createJob(int job_id, int priority, int job_type, int cpu_time_consumed, int memory_consumed) { // Allocates a CPUJob from the job pool
+    return new (jobPool.allocate()) CPUJob(job_id, priority, job_type, cpu_time_consumed, memory_consumed);
+}
+template <class DT>
+void NovelQueue<DT>::releaseJob(CPUJob* job) { // Returns a CPUJob to the job pool
+    jobPool.release(job);
+}
+template <class DT>
+unsigned int NovelQueue<DT>::nextPriority() { // Random heap priority for a new node (xorshift32)
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+template <class DT>
+int NovelQueue<DT>::sizeOf(Queue<DT>* node) { // Subtree size (0 for nullptr)
+    return node ? node->subtreeSize : 0;
+}
+template <class DT>
+void NovelQueue<DT>::update(Queue<DT>* node) { // Recomputes a node's subtree size and re-parents its children
+    node->subtreeSize = 1 + sizeOf(node->left) + sizeOf(node->right);
+    if (node->left) {
+        node->left->parent = node;
+    }
+    if (node->right) {
+        node->right->parent = node;
+    }
+}
+template <class DT>
+Queue<DT>* NovelQueue<DT>::merge(Queue<DT>* a, Queue<DT>* b) { // Joins two treaps, all of a ahead of all of b
+    if (!a) {
+        return b;
+    }
+    if (!b) {
+        return a;
+    }
+    if (a->heapPriority >= b->heapPriority) { // a stays on top, b joins its right subtree
+        a->right = merge(a->right, b);
+        update(a);
+        return a;
+    }
+    b->left = merge(a, b->left); // b stays on top, a joins its left subtree
+    update(b);
+    return b;
+}
+template <class DT>
+void NovelQueue<DT>::split(Queue<DT>* node, int k, Queue<DT>*& a, Queue<DT>*& b) { // Splits a treap into its first k nodes and the rest
+    if (!node) {
+        a = nullptr;
+        b = nullptr;
+        return;
+    }
+    if (sizeOf(node->left) < k) { // node belongs to the first part
+        split(node->right, k - sizeOf(node->left) - 1, node->right, b);
+        update(node);
+        a = node;
+    }
+    else { // node belongs to the second part
+        split(node->left, k, a, node->left);
+        update(node);
+        b = node;
+    }
+    if (a) {
+        a->parent = nullptr;
+    }
+    if (b) {
+        b->parent = nullptr;
+    }
+}
+template <class DT>
+Queue<DT>* NovelQueue<DT>::build(Queue<DT>** nodes, int n) { // Builds a treap from nodes already in queue order in O(n)
+    // Standard Cartesian tree construction: the stack holds the right spine of the tree built so far.
+    Queue<DT>** stack = new Queue<DT>*[n > 0 ? n : 1];
+    int top = 0;
+    for (int i = 0; i < n; i++) {
+        Queue<DT>* node = nodes[i];
+        node->left = nullptr;
+        node->right = nullptr;
+        node->parent = nullptr;
+        Queue<DT>* last = nullptr;
+        while (top > 0 && stack[top - 1]->heapPriority < node->heapPriority) { // Pop nodes that must sit below the new one
+            last = stack[--top];
+        }
+        node->left = last;
+        if (top > 0) {
+            stack[top - 1]->right = node;
+        }
+        stack[top++] = node;
+    }
+    Queue<DT>* result = top > 0 ? stack[0] : nullptr;
+    delete[] stack;
+    // Fix subtree sizes and parents bottom-up (reverse of a pre-order walk visits children before parents)
+    Queue<DT>** order = new Queue<DT>*[n > 0 ? n : 1];
+    int count = 0;
+    if (result) {
+        order[count++] = result;
+    }
+    for (int i = 0; i < count; i++) {
+        if (order[i]->left) {
+            order[count++] = order[i]->left;
+        }
+        if (order[i]->right) {
+            order[count++] = order[i]->right;
         }
-        newArray[i] = NodePtrs[i];
     }
-    newArray[size] = new Queue<DT>(newJob); // Put newJob into array
-    if (size == 0) { // Verifying whether front should be pointing to newJob
-        front = newArray[size];
+    for (int i = count - 1; i >= 0; i--) {
+        update(order[i]);
     }
-    else { // If it doesn't go at the front then just put it at the end of queue
-        newArray[size - 1]->next = newArray[size];
+    if (result) {
+        result->parent = nullptr;
+    }
+    delete[] order;
+    return result;
+}
+template <class DT>
+int NovelQueue<DT>::rankOf(Queue<DT>* node) { // Position of a node in the queue
+    int rank = sizeOf(node->left);
+    while (node->parent) { // Every time we come up from a right child, the parent and its left subtree are ahead of us
+        if (node->parent->right == node) {
+            rank += sizeOf(node->parent->left) + 1;
+        }
+        node = node->parent;
+    }
+    return rank;
+}
+template <class DT>
+int NovelQueue<DT>::enqueue(CPUJob* newJob) { // Enqueue method
+    Queue<DT>* node = new (nodePool.allocate()) Queue<DT>(newJob, nextPriority()); // Create a node for newJob
+    if (!index.insert(newJob->job_id, node)) { // Check to see if newJob is already within the queue
+        nodePool.release(node);
+        return -1; // Return -1 so that we can show job is already within queue
     }
-    newArray[size]->next = nullptr; // Set the very end to nullptr
-    delete[] NodePtrs; // Delete old NodePtrs array
-    NodePtrs = newArray; // Copy new array into NodePtrs
+    root = merge(root, node); // Put it at the end of queue
+    root->parent = nullptr;
     size++; // Increment size
+    if (queries) {
+        queries->add(newJob);
+    }
+    if (journal) {
+        journal->append(QueueLog::ENQUEUE, newJob->job_id, newJob->priority, newJob->job_type, newJob->cpu_time_consumed, newJob->memory_consumed);
+    }
     return 1; // Return number of nodes enqueued (you can only enqueue one at a time)
-}   
+}
+template <class DT>
+int NovelQueue<DT>::enqueueBatch(CPUJob** newJobs, int n, bool* added) { // Adds several jobs at once, marking which ones were added
+    Queue<DT>** nodes = new Queue<DT>*[n > 0 ? n : 1]; // New nodes in queue order
+    int k = 0;
+    index.reserve(n);
+    const int PREFETCH_DISTANCE = 16; // Hash slots are random accesses, so request them a few jobs ahead
+    for (int i = 0; i < n && i < PREFETCH_DISTANCE; i++) {
+        index.prefetch(newJobs[i]->job_id);
+    }
+    for (int i = 0; i < n; i++) {
+        if (i + PREFETCH_DISTANCE < n) {
+            index.prefetch(newJobs[i + PREFETCH_DISTANCE]->job_id);
+        }
+        nodes[k] = new (nodePool.allocate()) Queue<DT>(newJobs[i], nextPriority());
+        added[i] = index.insert(newJobs[i]->job_id, nodes[k]); // Duplicates (including within the batch) are skipped
+        if (!added[i]) {
+            nodePool.release(nodes[k]);
+        }
+        else {
+            k++;
+            if (queries) {
+                queries->add(newJobs[i]);
+            }
+            if (journal) {
+                journal->append(QueueLog::ENQUEUE, newJobs[i]->job_id, newJobs[i]->priority, newJobs[i]->job_type, newJobs[i]->cpu_time_consumed, newJobs[i]->memory_consumed);
+            }
+        }
+    }
+    root = merge(root, build(nodes, k)); // Build the new jobs into one treap and attach it at the end of queue
+    if (root) {
+        root->parent = nullptr;
+    }
+    size += k;
+    delete[] nodes;
+    return k; // Return number of nodes enqueued
+}
 template <class DT>
 CPUJob* NovelQueue<DT>::dequeue() { // Dequeue method
     if (size == 0) // There is nothing to dequeue
         return nullptr;
-    CPUJob* result = (*front).JobPointer; // Front element is going to be dequeued
-
-    for (int i = 0; i < size - 1; i++) { // Move every element in array to the left one
-        NodePtrs[i] = NodePtrs[i + 1];
+    Queue<DT>* front; // Front element is going to be dequeued
+    split(root, 1, front, root);
+    CPUJob* result = front->JobPointer;
+    index.erase(result->job_id);
+    if (queries) {
+        queries->remove(result);
     }
+    nodePool.release(front); // The node goes back to the pool, the job is handed to the caller
     size--; // Decrement size
-    if (size > 0) { // Checking to see if there is any elements to make front point to
-        front = NodePtrs[0];
-    } else { // If there is no elements, front = NULL
-        front = nullptr;
+    if (journal) {
+        journal->append(QueueLog::DEQUEUE);
     }
     return result; // Return resulting dequeued element
 }
 template <class DT>
+CPUJob* NovelQueue<DT>::remove(int job_id) { // Removes a job from anywhere in the queue and returns it
+    Queue<DT>* node = index.find(job_id);
+    if (!node) { // If job is not found
+        return nullptr;
+    }
+    int pos = rankOf(node);
+    Queue<DT>* before;
+    Queue<DT>* rest;
+    Queue<DT>* after;
+    split(root, pos, before, rest); // Cut the node out and join the two sides back together
+    split(rest, 1, node, after);
+    root = merge(before, after);
+    CPUJob* result = node->JobPointer;
+    index.erase(job_id);
+    if (queries) {
+        queries->remove(result);
+    }
+    nodePool.release(node);
+    size--;
+    if (journal) {
+        journal->append(QueueLog::REMOVE, job_id);
+    }
+    return result;
+}
+template <class DT>
 int NovelQueue<DT>::modify(int job_id, int new_priority, int new_job_type, int new_cpu_time_consumed, int new_memory_consumed) { // Modify a job's variables based on its job_id
-    int jobPos = incrementalSearch(job_id); // Find job to modify
-    NodePtrs[jobPos]->JobPointer = new CPUJob(job_id, new_priority, new_job_type, new_cpu_time_consumed, new_memory_consumed); // Modify the CPUJob object
-    return jobPos; // Return index of job within array
+    Queue<DT>* node = index.find(job_id); // Find job to modify
+    if (!node) { // If job is not found
+        return -1;
+    }
+    CPUJob* job = node->JobPointer;
+    if (queries) { // Index entries are keyed by the old values
+        queries->remove(job);
+    }
+    job->priority = new_priority; // Modify the CPUJob object in place
+    job->job_type = new_job_type;
+    job->cpu_time_consumed = new_cpu_time_consumed;
+    job->memory_consumed = new_memory_consumed;
+    if (queries) {
+        queries->add(job);
+    }
+    if (journal) {
+        journal->append(QueueLog::MODIFY, job_id, new_priority, new_job_type, new_cpu_time_consumed, new_memory_consumed);
+    }
+    return rankOf(node); // Return position of job within queue
 }
 template <class DT>
 int NovelQueue<DT>::change(int job_id, int field_index, int new_value) { // Change one specific variable within CPUJob based on the job_id and the field_index (desired variable to change)
-    int jobPos = incrementalSearch(job_id); // Find job to modify
-    if (jobPos == -1) { // If job is not found
+    Queue<DT>* node = index.find(job_id); // Find job to modify
+    if (!node) { // If job is not found
         return -1;
     }
+    if (queries) { // Index entries are keyed by the old values
+        queries->remove(node->JobPointer);
+    }
     switch (field_index) { // Switch/case with the variables to alter based on field_index
         case 1: { // Altering priority
-            NodePtrs[jobPos]->JobPointer->priority = new_value;
+            node->JobPointer->priority = new_value;
             break;
         }
         case 2: { // Altering job_type
-            NodePtrs[jobPos]->JobPointer->job_type = new_value;
+            node->JobPointer->job_type = new_value;
             break;
         }
         case 3: { // Altering cpu_time_consumed
-            NodePtrs[jobPos]->JobPointer->cpu_time_consumed = new_value;
+            node->JobPointer->cpu_time_consumed = new_value;
             break;
         }
         case 4: { // Altering memory_consumed
-            NodePtrs[jobPos]->JobPointer->memory_consumed = new_value;
+            node->JobPointer->memory_consumed = new_value;
             break;
         }
     }
-    return jobPos; // Return index of job within array
+    if (queries) {
+        queries->add(node->JobPointer);
+    }
+    if (journal) {
+        journal->append(QueueLog::CHANGE, job_id, field_index, new_value);
+    }
+    return rankOf(node); // Return position of job within queue
 }
 template <class DT>
 int NovelQueue<DT>::promote(int job_id, int positions) { // Promote a job within the queue
-    int jobPos = incrementalSearch(job_id); // Find job to promote
-    int newPos = jobPos - positions; // Find its new position within the array
+    Queue<DT>* node = index.find(job_id); // Find job to promote
+    if (!node) { // If job is not found
+        return -1;
+    }
+    int jobPos = rankOf(node);
+    int newPos = jobPos - positions; // Find its new position within the queue
+    if (newPos < 0) { // Cannot move past the front
+        newPos = 0;
+    }
+    if (newPos > jobPos) { // Negative promotions are ignored
+        newPos = jobPos;
+    }
 
-    Queue<DT>** newArray = new Queue<DT>*[size]; // Create new array
-    for (int i = 0, j = 0; i < size; i++, j++) { // Copy over NodePtrs to newArray
-        if (i == newPos) { // Determine whether current index is newPos
-            if (i == 0) {
-                front = NodePtrs[jobPos]; // If job is now front of the queue make it front
-            }
-            newArray[i] = NodePtrs[jobPos]; // Move job to new position
-            i++;
-        }
-        if (j == jobPos) { // Make sure we do not move the job to the newArray twice
-            j++;
-        }
-        newArray[i] = NodePtrs[j]; // Copy current index of NodePtrs to newArray
+    Queue<DT>* ahead; // Nodes in front of newPos
+    Queue<DT>* passed; // Nodes the job moves ahead of
+    Queue<DT>* rest; // The job followed by everything behind it
+    Queue<DT>* behind;
+    split(root, jobPos, ahead, rest);
+    split(rest, 1, node, behind);
+    split(ahead, newPos, ahead, passed);
+    root = merge(merge(ahead, node), merge(passed, behind)); // Reassemble with the job in its new position
+    root->parent = nullptr;
+    if (journal) {
+        journal->append(QueueLog::PROMOTE, job_id, positions);
     }
-    NodePtrs = newArray; // Make NodePtrs = newArray
-    return newPos; // Return new position within array
+    return newPos; // Return new position within queue
 }
 template <class DT>
 void NovelQueue<DT>::reorder(int attribute_index) { // Reorder the queue based on an attribute
+    if (attribute_index < 1 || attribute_index > 5 || size == 0) { // Unknown attribute leaves the queue as is
+        return;
+    }
 
-    Queue<DT>** newArray = new Queue<DT>*[size]; // Create a temporary newArray
+    Queue<DT>** nodes = new Queue<DT>*[size]; // Nodes in current queue order
+    int n = 0;
+    Queue<DT>** stack = new Queue<DT>*[size];
+    int top = 0;
+    Queue<DT>* current = root;
+    while (current || top > 0) { // Iterative in-order walk
+        while (current) {
+            stack[top++] = current;
+            current = current->left;
+        }
+        current = stack[--top];
+        nodes[n++] = current;
+        current = current->right;
+    }
+    delete[] stack;
 
-    // In every switch/case is its own sorting algorithm based on the attribute to be sorted by
-    switch (attribute_index) {
-        case 1: { // Sort by job_id (no need to account for duplicates)
-            for (int i = 0; i < size; i++) {
-                int index = i;
-                for (int j = i + 1; j < size; j++) {
-                    if (NodePtrs[j]->JobPointer->job_id < NodePtrs[index]->JobPointer->job_id) {
-                        index = j;
-                    }
-                }
-                newArray[i] = NodePtrs[index];
-                Queue<DT>* temp = NodePtrs[i];
-                NodePtrs[i] = NodePtrs[index];
-                NodePtrs[index] = temp;
-            }
-            break;
+    // Gather one key column for the attribute (ties are broken by job_id), so the sort only touches this column
+    // rather than chasing every node and job. Each key packs (attribute, job_id) into 64 bits, offset so negative values still order correctly.
+    unsigned long long* keys = new unsigned long long[size];
+    int* order = new int[size];
+    for (int i = 0; i < size; i++) {
+        CPUJob* job = nodes[i]->JobPointer;
+        int attribute;
+        switch (attribute_index) {
+            case 1: attribute = job->job_id; break;
+            case 2: attribute = job->priority; break;
+            case 3: attribute = job->job_type; break;
+            case 4: attribute = job->cpu_time_consumed; break;
+            default: attribute = job->memory_consumed; break;
         }
-        case 2: { // Sort by priority (Stable sort)
-            for (int i = 0; i < size; i++) {
-                int index = i;
-                for (int j = i + 1; j < size; j++) {
-                    if (NodePtrs[j]->JobPointer->priority < NodePtrs[index]->JobPointer->priority ||
-                        (NodePtrs[j]->JobPointer->priority == NodePtrs[index]->JobPointer->priority &&
-                        NodePtrs[j]->JobPointer->job_id < NodePtrs[index]->JobPointer->job_id)) {
-                        index = j;
-                    }
-                }
-                newArray[i] = NodePtrs[index];
-                Queue<DT>* temp = NodePtrs[i];
-                NodePtrs[i] = NodePtrs[index];
-                NodePtrs[index] = temp;
+        keys[i] = ((unsigned long long)((unsigned int)attribute ^ 0x80000000u) << 32) | ((unsigned int)job->job_id ^ 0x80000000u);
+        order[i] = i;
+    }
+    sort(order, order + size, [keys](int a, int b) { return keys[a] < keys[b]; }); // Keys are unique because job_ids are
+
+    Queue<DT>** sorted = new Queue<DT>*[size]; // Apply the sorted order to the nodes
+    for (int i = 0; i < size; i++) {
+        sorted[i] = nodes[order[i]];
+    }
+    root = build(sorted, size); // Rebuild the treap in the new order
+    if (journal) {
+        journal->append(QueueLog::REORDER, attribute_index);
+    }
+
+    delete[] nodes;
+    delete[] sorted;
+    delete[] keys;
+    delete[] order;
+}
+template <class DT>
+void NovelQueue<DT>::display() { // Walks the queue in order printing all nodes
+    Queue<DT>* current = root;
+    while (current && current->left) { // Start at the front of the queue
+        current = current->left;
+    }
+    while (current) {
+        current->JobPointer->display();
+        if (current->right) { // Next node is the leftmost node of the right subtree
+            current = current->right;
+            while (current->left) {
+                current = current->left;
             }
-            break;
         }
-        case 3: { // Sort by job_type (Stable sort)
-            for (int i = 0; i < size; i++) {
-                int index = i;
-                for (int j = i + 1; j < size; j++) {
-                    if (NodePtrs[j]->JobPointer->job_type < NodePtrs[index]->JobPointer->job_type ||
-                        (NodePtrs[j]->JobPointer->job_type == NodePtrs[index]->JobPointer->job_type &&
-                        NodePtrs[j]->JobPointer->job_id < NodePtrs[index]->JobPointer->job_id)) {
-                        index = j;
-                    }
-                }
-                newArray[i] = NodePtrs[index];
-                Queue<DT>* temp = NodePtrs[i];
-                NodePtrs[i] = NodePtrs[index];
-                NodePtrs[index] = temp;
+        else { // Otherwise climb until we come up from a left child
+            while (current->parent && current->parent->right == current) {
+                current = current->parent;
             }
-            break;
+            current = current->parent;
         }
-        case 4: { // Sort by cpu_time_consumed (Stable sort)
-            for (int i = 0; i < size; i++) {
-                int index = i;
-                for (int j = i + 1; j < size; j++) {
-                    if (NodePtrs[j]->JobPointer->cpu_time_consumed < NodePtrs[index]->JobPointer->cpu_time_consumed ||
-                        (NodePtrs[j]->JobPointer->cpu_time_consumed == NodePtrs[index]->JobPointer->cpu_time_consumed &&
-                        NodePtrs[j]->JobPointer->job_id < NodePtrs[index]->JobPointer->job_id)) {
-                        index = j;
-                    }
-                }
-                newArray[i] = NodePtrs[index];
-                Queue<DT>* temp = NodePtrs[i];
-                NodePtrs[i] = NodePtrs[index];
-                NodePtrs[index] = temp;
+    }
+}
+template <class DT>
+void NovelQueue<DT>::display(OutputBuffer& out) { // Walks the queue in order writing all nodes to an output buffer
+    Queue<DT>* current = root;
+    while (current && current->left) { // Start at the front of the queue
+        current = current->left;
+    }
+    while (current) {
+        current->JobPointer->display(out);
+        if (current->right) { // Next node is the leftmost node of the right subtree
+            current = current->right;
+            while (current->left) {
+                current = current->left;
             }
-            break;
         }
-        case 5: { // Sort by memory_consumed (Stable sort)
-            for (int i = 0; i < size; i++) {
-                int index = i;
-                for (int j = i + 1; j < size; j++) {
-                    if (NodePtrs[j]->JobPointer->memory_consumed < NodePtrs[index]->JobPointer->memory_consumed ||
-                        (NodePtrs[j]->JobPointer->memory_consumed == NodePtrs[index]->JobPointer->memory_consumed &&
-                        NodePtrs[j]->JobPointer->job_id < NodePtrs[index]->JobPointer->job_id)) {
-                        index = j;
-                    }
-                }
-                newArray[i] = NodePtrs[index];
-                Queue<DT>* temp = NodePtrs[i];
-                NodePtrs[i] = NodePtrs[index];
-                NodePtrs[index] = temp;
+        else { // Otherwise climb until we come up from a left child
+            while (current->parent && current->parent->right == current) {
+                current = current->parent;
             }
-            break;
+            current = current->parent;
         }
     }
-
-    // Reassign NodePtrs to the sorted array
-    delete[] NodePtrs; // Free the old array
-    NodePtrs = newArray;
-}
-template <class DT>
-void NovelQueue<DT>::display() { // Increments through NodePtrs printing all nodes
-    for (int i = 0; i < size; i++) { // Displays all nodes within NodePtrs
-        NodePtrs[i]->JobPointer->display();
-    }
 }
 template <class DT>
 int NovelQueue<DT>::count() {
-    return size; // Return size of NodePtrs
+    return size; // Return number of nodes in the queue
 }
 template <class DT>
-int NovelQueue<DT>::binarySearch(int key) { // Performs a binary search on NodePtrs and returns the index of the key
-    int L = 0;
-    int R = size - 1;
-    while (L <= R) {
-        int mid = (L+R) / 2;
-        if (NodePtrs[mid]->JobPointer->job_id == key) {
-            return mid; // Returns index when found
+CPUJob* NovelQueue<DT>::jobAt(int position) { // Returns the job at a position in the queue (0 is the front)
+    if (position < 0 || position >= size) {
+        return nullptr;
+    }
+    Queue<DT>* current = root;
+    while (true) { // Descend using subtree sizes
+        int leftSize = sizeOf(current->left);
+        if (position < leftSize) {
+            current = current->left;
         }
-        if (NodePtrs[mid]->JobPointer->job_id < key) {
-            L = mid + 1;
+        else if (position == leftSize) {
+            return current->JobPointer;
         }
         else {
-            R = mid - 1;
+            position -= leftSize + 1;
+            current = current->right;
         }
     }
-    return -1; // Returns -1 if unfound
 }
 template <class DT>
-int NovelQueue<DT>::incrementalSearch(int key) { // Performs an incremental search on NodePtrs and returns index of the key
-    for (int i = 0; i < size; i++) {
-        if (NodePtrs[i]->JobPointer->job_id == key) {
-            return i; // Returns index when found
+int NovelQueue<DT>::position(int job_id) { // Returns the position of a job in the queue, or -1 if it is not queued
+    Queue<DT>* node = index.find(job_id);
+    if (!node) {
+        return -1; // Returns -1 if unfound
+    }
+    return rankOf(node);
+}
+template <class DT>
+template <class Visitor>
+void NovelQueue<DT>::forEach(Visitor visit) { // Calls visit(job) for every job in queue order
+    Queue<DT>* current = root;
+    while (current && current->left) { // Start at the front of the queue
+        current = current->left;
+    }
+    while (current) {
+        visit(current->JobPointer);
+        if (current->right) { // Next node is the leftmost node of the right subtree
+            current = current->right;
+            while (current->left) {
+                current = current->left;
+            }
+        }
+        else { // Otherwise climb until we come up from a left child
+            while (current->parent && current->parent->right == current) {
+                current = current->parent;
+            }
+            current = current->parent;
         }
     }
-
-    return -1; // Returns -1 if unfound
 }
-
-// Main program for organizing and manipulating input for proper output.
-int main() {
-    int n; // Number of commands
-    cin >> n; // Read in the number of commands
-
-    NovelQueue<CPUJob*>* myNovelQueue = new NovelQueue<CPUJob*>(); // Instantiate a NovelQueue for CPUJob pointers
-
-    char command; // Variable to store the command type
-
-    // Job attribute declaration placeholders
-    int job_id, priority, job_type, cpu_time_consumed, memory_consumed;
-
-    // Job attribute modification placeholders
-    int new_priority, new_job_type, new_cpu_time_consumed;
-    int new_memory_consumed;
-    int field_index, new_value;
-
-    int positions; // Variable to store number of positions in the 'Promote' command
-    int attribute_index; // Variable for the 'Reorder' command
-
-    for (int i = 0; i < n; i++) {
-        cin >> command; // Read in command type
-        // Here we are parsing through the commands to determine which one should be performed based on the command type
-        switch (command) {
+template <class DT>
+CPUJob* NovelQueue<DT>::find(int job_id) { // Returns the queued job with a job_id
+    Queue<DT>* node = index.find(job_id);
+    return node ? node->JobPointer : nullptr;
+}
+template <class DT>
+QueryIndex* NovelQueue<DT>::queryIndex() { // Builds the indexes on first use, after which every change keeps them current
+    if (!queries) {
+        queries = new QueryIndex();
+        QueryIndex* built = queries;
+        forEach([built](CPUJob* job) { built->add(job); });
+    }
+    return queries;
+}
+template <class DT>
+template <class Visitor>
+int NovelQueue<DT>::queryRange(int field, int low, int high, Visitor visit) { // Jobs with low <= field <= high
+    return queryIndex()->range(field, low, high, [this, &visit](int job_id) { visit(index.find(job_id)->JobPointer); });
+}
+template <class DT>
+template <class Visitor>
+int NovelQueue<DT>::queryTop(int field, int k, Visitor visit) { // The k jobs with the largest field
+    return queryIndex()->top(field, k, [this, &visit](int job_id) { visit(index.find(job_id)->JobPointer); });
+}
+template <class DT>
+template <class Visitor>
+int NovelQueue<DT>::queryRangeWhere(int equalField, int equalValue, int rangeField, int low, int high, Visitor visit) { // Range query among jobs whose equalField == equalValue
+    return queryIndex()->rangeWhere(equalField, equalValue, rangeField, low, high, [this, &visit](int job_id) { visit(index.find(job_id)->JobPointer); });
+}
+template <class DT>
+template <class Visitor>
+int NovelQueue<DT>::queryGroupCount(int field, Visitor visit) { // Each distinct value of a field with its number of jobs
+    return queryIndex()->groupCount(field, visit);
+}
+
+// Writes a compact binary snapshot of the queue, then starts a fresh log generation.
+// The snapshot is a 32 byte header (magic, generation, job count, checksum) followed by five 32-bit fields per job in queue order.
+// It is written to a temporary file and renamed into place, so a crash leaves either the old or the new snapshot. A log whose
+// generation is older than the snapshot's is already covered by it and is ignored on recovery.
+void saveSnapshot(NovelQueue<CPUJob*>* queue, QueueLog* journal) {
+    journal->commit();
+    unsigned long long newGeneration = journal->generation + 1;
+    string temporaryPath = journal->snapshotPath() + ".tmp";
+    int fd = open(temporaryPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        cerr << "Cannot write " << temporaryPath << endl;
+        return;
+    }
+    unsigned long long header[4] = {0, newGeneration, (unsigned long long)queue->count(), 0};
+    memcpy(&header[0], "NQSNAP01", 8);
+    const int CHUNK_JOBS = 1 << 16; // Jobs written per write call
+    unsigned int* chunk = new unsigned int[CHUNK_JOBS * 5];
+    bool ok = pwrite(fd, header, sizeof(header), 0) == (ssize_t)sizeof(header); // Placeholder header, rewritten with the checksum at the end
+    off_t offset = sizeof(header);
+    unsigned long long hash = 14695981039346656037ull;
+    int count = queue->count();
+    int inChunk = 0;
+    queue->forEach([&](CPUJob* job) { // Walk the queue in order
+        unsigned int* fields = chunk + inChunk * 5;
+        fields[0] = (unsigned int)job->job_id;
+        fields[1] = (unsigned int)job->priority;
+        fields[2] = (unsigned int)job->job_type;
+        fields[3] = (unsigned int)job->cpu_time_consumed;
+        fields[4] = (unsigned int)job->memory_consumed;
+        inChunk++;
+        if (inChunk == CHUNK_JOBS) {
+            hash = checksumWords(chunk, (long long)inChunk * 5, hash);
+            ok = ok && pwrite(fd, chunk, inChunk * 20, offset) == inChunk * 20;
+            offset += inChunk * 20;
+            inChunk = 0;
+        }
+    });
+    hash = checksumWords(chunk, (long long)inChunk * 5, hash);
+    ok = ok && pwrite(fd, chunk, inChunk * 20, offset) == inChunk * 20;
+    header[3] = hash;
+    ok = ok && pwrite(fd, header, sizeof(header), 0) == (ssize_t)sizeof(header);
+    ok = ok && fsync(fd) == 0;
+    close(fd);
+    delete[] chunk;
+    if (!ok || count != queue->count() || rename(temporaryPath.c_str(), journal->snapshotPath().c_str()) != 0) {
+        cerr << "Snapshot to " << journal->snapshotPath() << " failed" << endl;
+        return;
+    }
+    int directoryFd = open(journal->directory.c_str(), O_RDONLY); // Make the rename itself durable
+    if (directoryFd >= 0) {
+        fsync(directoryFd);
+        close(directoryFd);
+    }
+    journal->reset(newGeneration); // Everything logged so far is now in the snapshot
+}
+
+// Applies one log record to the queue (the queue's journal must be detached while replaying).
+void replayRecord(NovelQueue<CPUJob*>* queue, const unsigned int* record) {
+    int a[5];
+    for (int i = 0; i < 5; i++) {
+        a[i] = (int)record[2 + i];
+    }
+    switch (record[1]) {
+        case QueueLog::ENQUEUE: {
+            CPUJob* job = queue->createJob(a[0], a[1], a[2], a[3], a[4]);
+            if (queue->enqueue(job) < 1) {
+                queue->releaseJob(job);
+            }
+            break;
+        }
+        case QueueLog::DEQUEUE: queue->releaseJob(queue->dequeue()); break;
+        case QueueLog::REMOVE: queue->releaseJob(queue->remove(a[0])); break;
+        case QueueLog::MODIFY: queue->modify(a[0], a[1], a[2], a[3], a[4]); break;
+        case QueueLog::CHANGE: queue->change(a[0], a[1], a[2]); break;
+        case QueueLog::PROMOTE: queue->promote(a[0], a[1]); break;
+        case QueueLog::REORDER: queue->reorder(a[0]); break;
+    }
+}
+
+// Restores the queue from the snapshot (memory-mapped) and the tail of the log, then attaches the log to the queue.
+// Returns the number of log records replayed.
+long long recoverQueue(NovelQueue<CPUJob*>* queue, QueueLog* journal) {
+    queue->journal = nullptr; // Nothing recovered is logged again
+    unsigned long long snapshotGeneration = 0;
+    int fd = open(journal->snapshotPath().c_str(), O_RDONLY);
+    if (fd >= 0) {
+        struct stat info;
+        fstat(fd, &info);
+        if (info.st_size >= 32) {
+            void* mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped != MAP_FAILED) {
+                madvise(mapped, info.st_size, MADV_SEQUENTIAL);
+                const unsigned long long* header = (const unsigned long long*)mapped;
+                const unsigned int* fields = (const unsigned int*)((const char*)mapped + 32);
+                long long count = (long long)header[2];
+                bool valid = memcmp(mapped, "NQSNAP01", 8) == 0 && 32 + count * 20 <= (long long)info.st_size
+                    && checksumWords(fields, count * 5) == header[3];
+                if (valid) {
+                    snapshotGeneration = header[1];
+                    CPUJob** jobs = new CPUJob*[count > 0 ? count : 1];
+                    bool* added = new bool[count > 0 ? count : 1];
+                    for (long long i = 0; i < count; i++, fields += 5) {
+                        jobs[i] = queue->createJob((int)fields[0], (int)fields[1], (int)fields[2], (int)fields[3], (int)fields[4]);
+                    }
+                    queue->enqueueBatch(jobs, (int)count, added); // Builds the whole queue in O(n)
+                    delete[] jobs;
+                    delete[] added;
+                }
+                else {
+                    cerr << "Ignoring corrupt snapshot " << journal->snapshotPath() << endl;
+                }
+                munmap(mapped, info.st_size);
+            }
+        }
+        close(fd);
+    }
+
+    long long replayed = 0;
+    if (journal->generation < snapshotGeneration) { // Crashed between writing the snapshot and resetting the log
+        journal->reset(snapshotGeneration);
+    }
+    else {
+        off_t end = lseek(journal->fd, 0, SEEK_END);
+        off_t offset = QueueLog::HEADER_BYTES;
+        const int CHUNK_RECORDS = 4096;
+        const int RECORD_BYTES = QueueLog::RECORD_WORDS * 4;
+        unsigned int* chunk = new unsigned int[CHUNK_RECORDS * QueueLog::RECORD_WORDS];
+        bool torn = false;
+        while (offset + RECORD_BYTES <= end && !torn) { // Replay whole records until the end or the first damaged one
+            ssize_t got = pread(journal->fd, chunk, CHUNK_RECORDS * RECORD_BYTES, offset);
+            int records = got > 0 ? (int)(got / RECORD_BYTES) : 0;
+            if (records == 0) {
+                break;
+            }
+            for (int i = 0; i < records; i++) {
+                const unsigned int* record = chunk + i * QueueLog::RECORD_WORDS;
+                if ((unsigned int)checksumWords(record + 1, QueueLog::RECORD_WORDS - 1) != record[0]) {
+                    torn = true;
+                    break;
+                }
+                replayRecord(queue, record);
+                offset += RECORD_BYTES;
+                replayed++;
+            }
+        }
+        delete[] chunk;
+        if (offset != end && ftruncate(journal->fd, offset) == 0) { // Drop a torn tail so new records follow valid ones
+            fdatasync(journal->fd);
+        }
+        journal->recordsSinceSnapshot = replayed;
+    }
+    queue->journal = journal;
+    return replayed;
+}
+
+// A job waiting for or receiving CPU time inside the JobExecutor.
+class ScheduledJob {
+    public:
+        CPUJob* job; // The job being scheduled
+        long long remaining; // CPU time still needed before the job finishes
+        long long sequence; // Arrival order, used to break ties between equal keys
+        int level; // Current feedback level (only used by MLFQPolicy, 0 is the highest)
+};
+
+// Double-ended queue of scheduled jobs (the owner works from the front, idle cores steal from the back).
+class JobDeque {
+    public:
+        ScheduledJob* jobs; // Circular buffer of scheduled jobs
+        int capacity; // Number of slots allocated in jobs
+        int head; // Index of the front job within jobs
+        int length; // Number of jobs currently in the deque
+        JobDeque(); // Default constructor
+        ~JobDeque(); // Destructor
+        void pushBack(const ScheduledJob& task); // Add a job to the back of the deque
+        void pushFront(const ScheduledJob& task); // Put a job back at the front of the deque
+        bool popFront(ScheduledJob& task); // Remove the front job (owner side), returns false when empty
+        bool popBack(ScheduledJob& task); // Remove the back job (thief side), returns false when empty
+        int count(); // Returns number of jobs in the deque
+        void grow(); // Doubles the capacity of the circular buffer
+};
+JobDeque::JobDeque() { // Default constructor
+    (*this).capacity = 8;
+    (*this).head = 0;
+    (*this).length = 0;
+    jobs = new ScheduledJob[capacity];
+}
+JobDeque::~JobDeque() { // Destructor
+    delete[] jobs;
+}
+void JobDeque::grow() { // Doubles the capacity of the circular buffer
+    ScheduledJob* newJobs = new ScheduledJob[capacity * 2];
+    for (int i = 0; i < length; i++) { // Unwrap the circular buffer into the new array
+        newJobs[i] = jobs[(head + i) % capacity];
+    }
+    delete[] jobs;
+    jobs = newJobs;
+    capacity *= 2;
+    head = 0;
+}
+void JobDeque::pushBack(const ScheduledJob& task) { // Add a job to the back of the deque
+    if (length == capacity) {
+        grow();
+    }
+    jobs[(head + length) % capacity] = task;
+    length++;
+}
+void JobDeque::pushFront(const ScheduledJob& task) { // Put a job back at the front of the deque
+    if (length == capacity) {
+        grow();
+    }
+    head = (head + capacity - 1) % capacity;
+    jobs[head] = task;
+    length++;
+}
+bool JobDeque::popFront(ScheduledJob& task) { // Remove the front job (owner side)
+    if (length == 0) {
+        return false;
+    }
+    task = jobs[head];
+    head = (head + 1) % capacity;
+    length--;
+    return true;
+}
+bool JobDeque::popBack(ScheduledJob& task) { // Remove the back job (thief side)
+    if (length == 0) {
+        return false;
+    }
+    length--;
+    task = jobs[(head + length) % capacity];
+    return true;
+}
+int JobDeque::count() { // Returns number of jobs in the deque
+    return length;
+}
+
+/*
+Scheduling policies for the JobExecutor. Each policy is one core's run queue and is passed to JobExecutor as a template
+parameter, so dispatch is resolved at compile time. Every policy provides:
+    push(task)       - add a newly arrived job
+    putBack(task)    - return a job that could not start yet, keeping it next in line
+    preempted(task)  - return a job whose time slice ran out
+    take(task)       - remove the next job for the owning core
+    steal(task)      - remove a job on behalf of an idle core
+    quantum(task)    - length of the next time slice for a job
+    count()          - number of queued jobs
+    setWeights(w)    - share of each job_type, indexed by FairSharePolicy bucket (ignored by policies without shares)
+*/
+
+// First in, first out. Jobs run to completion in queue order.
+class FifoPolicy {
+    public:
+        JobDeque jobs; // Pending jobs in arrival order
+        void push(const ScheduledJob& task) { jobs.pushBack(task); }
+        void putBack(const ScheduledJob& task) { jobs.pushFront(task); }
+        void preempted(const ScheduledJob& task) { jobs.pushFront(task); }
+        bool take(ScheduledJob& task) { return jobs.popFront(task); }
+        bool steal(ScheduledJob& task) { return jobs.popBack(task); }
+        long long quantum(const ScheduledJob& task) { return task.remaining; }
+        int count() { return jobs.count(); }
+        void setWeights(const long long*) {}
+};
+
+// Shortest job first on cpu_time_consumed, backed by a binary min-heap (O(log n) push and take).
+class SJFPolicy {
+    public:
+        ScheduledJob* heap; // Binary min-heap ordered by (remaining, sequence)
+        int capacity; // Number of slots allocated in heap
+        int length; // Number of jobs in the heap
+        SJFPolicy(); // Default constructor
+        ~SJFPolicy(); // Destructor
+        void push(const ScheduledJob& task); // Add a job to the heap
+        void putBack(const ScheduledJob& task) { push(task); }
+        void preempted(const ScheduledJob& task) { push(task); }
+        bool take(ScheduledJob& task); // Remove the shortest job
+        bool steal(ScheduledJob& task) { return take(task); }
+        long long quantum(const ScheduledJob& task) { return task.remaining; }
+        int count() { return length; }
+        void setWeights(const long long*) {}
+        bool shorter(const ScheduledJob& a, const ScheduledJob& b); // Heap ordering
+};
+SJFPolicy::SJFPolicy() { // Default constructor
+    (*this).capacity = 8;
+    (*this).length = 0;
+    heap = new ScheduledJob[capacity];
+}
+SJFPolicy::~SJFPolicy() { // Destructor
+    delete[] heap;
+}
+bool SJFPolicy::shorter(const ScheduledJob& a, const ScheduledJob& b) { // Heap ordering
+    if (a.remaining != b.remaining) {
+        return a.remaining < b.remaining;
+    }
+    return a.sequence < b.sequence; // Equal lengths keep arrival order
+}
+void SJFPolicy::push(const ScheduledJob& task) { // Add a job to the heap
+    if (length == capacity) { // Double the heap array when full
+        ScheduledJob* newHeap = new ScheduledJob[capacity * 2];
+        for (int i = 0; i < length; i++) {
+            newHeap[i] = heap[i];
+        }
+        delete[] heap;
+        heap = newHeap;
+        capacity *= 2;
+    }
+    int i = length++;
+    while (i > 0 && shorter(task, heap[(i - 1) / 2])) { // Sift up
+        heap[i] = heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap[i] = task;
+}
+bool SJFPolicy::take(ScheduledJob& task) { // Remove the shortest job
+    if (length == 0) {
+        return false;
+    }
+    task = heap[0];
+    ScheduledJob last = heap[--length];
+    int i = 0;
+    while (2 * i + 1 < length) { // Sift down
+        int child = 2 * i + 1;
+        if (child + 1 < length && shorter(heap[child + 1], heap[child])) {
+            child++;
+        }
+        if (!shorter(heap[child], last)) {
+            break;
+        }
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = last;
+    return true;
+}
+
+// Multilevel feedback queue keyed on priority. Priority 10 starts at level 0 and priority 1 at level 9.
+// Level k gets a time slice of baseQuantum * 2^k, and a job that uses up its slice drops one level.
+// A bitmask of non-empty levels makes take() O(1).
+class MLFQPolicy {
+    public:
+        static const int LEVELS = 10; // Number of feedback levels
+        JobDeque levels[LEVELS]; // One FIFO queue per level
+        unsigned int nonEmpty; // Bit k is set when levels[k] holds jobs
+        long long baseQuantum; // Time slice of level 0
+        int length; // Number of queued jobs across all levels
+        MLFQPolicy(); // Default constructor
+        void push(const ScheduledJob& task); // Add a newly arrived job at the level of its priority
+        void putBack(const ScheduledJob& task); // Return a job to the front of its level
+        void preempted(const ScheduledJob& task); // Demote a job that used its whole slice
+        bool take(ScheduledJob& task); // Remove the front job of the highest non-empty level
+        bool steal(ScheduledJob& task); // Remove the back job of the lowest non-empty level
+        long long quantum(const ScheduledJob& task); // Slice length of the job's level
+        int count() { return length; }
+        void setWeights(const long long*) {}
+};
+MLFQPolicy::MLFQPolicy() { // Default constructor
+    (*this).nonEmpty = 0;
+    (*this).baseQuantum = 50;
+    (*this).length = 0;
+}
+void MLFQPolicy::push(const ScheduledJob& task) { // Add a newly arrived job at the level of its priority
+    ScheduledJob placed = task;
+    int priority = task.job->priority;
+    if (priority < 1) {
+        priority = 1;
+    }
+    if (priority > LEVELS) {
+        priority = LEVELS;
+    }
+    placed.level = LEVELS - priority;
+    levels[placed.level].pushBack(placed);
+    nonEmpty |= 1u << placed.level;
+    length++;
+}
+void MLFQPolicy::putBack(const ScheduledJob& task) { // Return a job to the front of its level
+    levels[task.level].pushFront(task);
+    nonEmpty |= 1u << task.level;
+    length++;
+}
+void MLFQPolicy::preempted(const ScheduledJob& task) { // Demote a job that used its whole slice
+    ScheduledJob demoted = task;
+    if (demoted.level < LEVELS - 1) {
+        demoted.level++;
+    }
+    levels[demoted.level].pushBack(demoted);
+    nonEmpty |= 1u << demoted.level;
+    length++;
+}
+bool MLFQPolicy::take(ScheduledJob& task) { // Remove the front job of the highest non-empty level
+    if (nonEmpty == 0) {
+        return false;
+    }
+    int level = __builtin_ctz(nonEmpty); // Lowest set bit is the highest level with work
+    levels[level].popFront(task);
+    if (levels[level].count() == 0) {
+        nonEmpty &= ~(1u << level);
+    }
+    length--;
+    return true;
+}
+bool MLFQPolicy::steal(ScheduledJob& task) { // Remove the back job of the lowest non-empty level
+    if (nonEmpty == 0) {
+        return false;
+    }
+    int level = 31 - __builtin_clz(nonEmpty); // Highest set bit is the lowest level with work
+    levels[level].popBack(task);
+    if (levels[level].count() == 0) {
+        nonEmpty &= ~(1u << level);
+    }
+    length--;
+    return true;
+}
+long long MLFQPolicy::quantum(const ScheduledJob& task) { // Slice length of the job's level
+    long long slice = baseQuantum << task.level;
+    return slice < task.remaining ? slice : task.remaining;
+}
+
+// Weighted fair share across job_type buckets using stride scheduling. Each job_type (1-10, bucket 0 holds any other type)
+// has a FIFO queue and a virtual pass value; take() serves the bucket with the smallest pass and advances it by
+// the job's CPU time divided by the bucket's weight. With a fixed number of buckets, take() is O(1).
+class FairSharePolicy {
+    public:
+        static const int BUCKETS = 11; // Job types 1-10 plus bucket 0 for anything else
+        JobDeque buckets[BUCKETS]; // One FIFO queue per job_type
+        long long weights[BUCKETS]; // Share of each job_type (defaults to 1)
+        long long pass[BUCKETS]; // Virtual time consumed by each job_type, scaled by its weight
+        long long globalPass; // Pass of the most recently served bucket, used to catch up idle buckets
+        int length; // Number of queued jobs across all buckets
+        FairSharePolicy(); // Default constructor
+        int bucketOf(const ScheduledJob& task); // Bucket for a job's job_type
+        void setWeights(const long long* shares); // Change the share of every job_type
+        void push(const ScheduledJob& task); // Add a job to its bucket
+        void putBack(const ScheduledJob& task); // Return a job to the front of its bucket and refund its charge
+        void preempted(const ScheduledJob& task) { putBack(task); }
+        bool take(ScheduledJob& task); // Remove the front job of the bucket with the smallest pass
+        bool steal(ScheduledJob& task) { return take(task); }
+        long long quantum(const ScheduledJob& task) { return task.remaining; }
+        int count() { return length; }
+};
+FairSharePolicy::FairSharePolicy() { // Default constructor
+    for (int i = 0; i < BUCKETS; i++) {
+        weights[i] = 1;
+        pass[i] = 0;
+    }
+    (*this).globalPass = 0;
+    (*this).length = 0;
+}
+int FairSharePolicy::bucketOf(const ScheduledJob& task) { // Bucket for a job's job_type
+    int type = task.job->job_type;
+    return (type >= 1 && type < BUCKETS) ? type : 0;
+}
+void FairSharePolicy::setWeights(const long long* shares) { // Change the share of every job_type
+    for (int i = 0; i < BUCKETS; i++) {
+        weights[i] = shares[i] > 0 ? shares[i] : 1;
+    }
+}
+void FairSharePolicy::push(const ScheduledJob& task) { // Add a job to its bucket
+    int b = bucketOf(task);
+    if (buckets[b].count() == 0 && pass[b] < globalPass) { // An idle bucket does not get credit for the time it was idle
+        pass[b] = globalPass;
+    }
+    buckets[b].pushBack(task);
+    length++;
+}
+void FairSharePolicy::putBack(const ScheduledJob& task) { // Return a job to the front of its bucket and refund its charge
+    int b = bucketOf(task);
+    pass[b] -= task.remaining * 1024 / weights[b];
+    buckets[b].pushFront(task);
+    length++;
+}
+bool FairSharePolicy::take(ScheduledJob& task) { // Remove the front job of the bucket with the smallest pass
+    int best = -1;
+    for (int b = 0; b < BUCKETS; b++) {
+        if (buckets[b].count() > 0 && (best == -1 || pass[b] < pass[best])) {
+            best = b;
+        }
+    }
+    if (best == -1) {
+        return false;
+    }
+    buckets[best].popFront(task);
+    globalPass = pass[best];
+    pass[best] += task.remaining * 1024 / weights[best]; // Charge the bucket for the CPU time it is about to use
+    length--;
+    return true;
+}
+
+// Results of running a queue of jobs through the JobExecutor.
+class ExecutionReport {
+    public:
+        int cores; // Number of simulated cores
+        long long memoryBudget; // Global memory budget shared by running jobs
+        int jobsRun; // Number of jobs that ran to completion
+        int jobsRejected; // Number of jobs that could never fit within the memory budget
+        int steals; // Number of jobs taken from another core's run queue
+        int preemptions; // Number of time slices that ended before their job finished
+        long long makespan; // Time at which the last job finished
+        long long busyTime; // Total CPU time spent running jobs across all cores
+        long long* latencies[11]; // Sorted completion latencies per priority (index 0 holds priorities outside 1-10)
+        int latencyCounts[11]; // Number of latencies recorded per priority
+        ExecutionReport(int cores, long long memoryBudget); // Constructor
+        ~ExecutionReport(); // Destructor
+        long long percentile(int priority, int percent); // Nearest-rank percentile of a priority's latencies
+        void display(OutputBuffer& out); // Display method
+};
+ExecutionReport::ExecutionReport(int cores, long long memoryBudget) { // Constructor
+    (*this).cores = cores;
+    (*this).memoryBudget = memoryBudget;
+    (*this).jobsRun = 0;
+    (*this).jobsRejected = 0;
+    (*this).steals = 0;
+    (*this).preemptions = 0;
+    (*this).makespan = 0;
+    (*this).busyTime = 0;
+    for (int i = 0; i < 11; i++) {
+        latencies[i] = nullptr;
+        latencyCounts[i] = 0;
+    }
+}
+ExecutionReport::~ExecutionReport() { // Destructor
+    for (int i = 0; i < 11; i++) {
+        delete[] latencies[i];
+    }
+}
+long long ExecutionReport::percentile(int priority, int percent) { // Nearest-rank percentile of a priority's latencies
+    int n = latencyCounts[priority];
+    if (n == 0) {
+        return 0;
+    }
+    int rank = (percent * n + 99) / 100; // ceil(percent / 100 * n)
+    if (rank < 1) {
+        rank = 1;
+    }
+    return latencies[priority][rank - 1];
+}
+void ExecutionReport::display(OutputBuffer& out) { // Display method
+    out << "Cores: " << cores << ", Memory Budget: " << memoryBudget << '\n';
+    out << "Jobs Run: " << jobsRun << ", Jobs Rejected: " << jobsRejected << ", Steals: " << steals << ", Preemptions: " << preemptions << '\n';
+    double utilization = 0.0;
+    if (makespan > 0) {
+        utilization = 100.0 * busyTime / ((double)makespan * cores);
+    }
+    out << "Makespan: " << makespan << ", Utilization: " << (long long)(utilization * 100 + 0.5) / 100.0 << "%" << '\n';
+    for (int p = 0; p < 11; p++) { // Latency percentiles for every priority that ran at least one job
+        if (latencyCounts[p] == 0) {
+            continue;
+        }
+        if (p == 0) {
+            out << "Priority other";
+        }
+        else {
+            out << "Priority " << p;
+        }
+        out << " (" << latencyCounts[p] << " job(s)) Latency p50: " << percentile(p, 50) << ", p90: " << percentile(p, 90) << ", p99: " << percentile(p, 99) << '\n';
+    }
+}
+
+// Discrete-event simulator that drains a NovelQueue onto a number of cores, each with its own Policy run queue, with work stealing.
+// Every job arrives at time 0 in queue order and needs cpu_time_consumed time units. A job holds memory_consumed of the
+// global memory budget while one of its time slices runs. A core whose next job does not fit in the free memory waits
+// for a running slice to finish.
+template <class Policy>
+class JobExecutor {
+    public:
+        int cores; // Number of simulated cores
+        long long memoryBudget; // Global memory budget shared by running jobs
+        Policy* queues; // One run queue per core
+        JobExecutor(int cores, long long memoryBudget, const long long* weights); // Constructor (weights may be nullptr for equal shares)
+        ~JobExecutor(); // Destructor
+        ExecutionReport* run(NovelQueue<CPUJob*>* queue); // Dequeue and execute every job in the queue, then delete the jobs
+        bool nextJob(int core, ScheduledJob& task, ExecutionReport* report); // Take the next job for a core, stealing from the busiest core if its own queue is empty
+};
+template <class Policy>
+JobExecutor<Policy>::JobExecutor(int cores, long long memoryBudget, const long long* weights) { // Constructor
+    if (cores < 1) { // There must be at least one core to run anything
+        cores = 1;
+    }
+    (*this).cores = cores;
+    (*this).memoryBudget = memoryBudget;
+    queues = new Policy[cores];
+    if (weights) { // Every core shares out its run queue the same way
+        for (int i = 0; i < cores; i++) {
+            queues[i].setWeights(weights);
+        }
+    }
+}
+template <class Policy>
+JobExecutor<Policy>::~JobExecutor() { // Destructor
+    delete[] queues;
+}
+template <class Policy>
+bool JobExecutor<Policy>::nextJob(int core, ScheduledJob& task, ExecutionReport* report) { // Take the next job for a core, stealing from the busiest core if its own queue is empty
+    if (queues[core].take(task)) {
+        return true;
+    }
+    int victim = -1; // Core with the most pending jobs
+    for (int c = 0; c < cores; c++) {
+        if (c != core && queues[c].count() > 0 && (victim == -1 || queues[c].count() > queues[victim].count())) {
+            victim = c;
+        }
+    }
+    if (victim == -1) { // Nothing left to steal
+        return false;
+    }
+    report->steals++;
+    return queues[victim].steal(task);
+}
+template <class Policy>
+ExecutionReport* JobExecutor<Policy>::run(NovelQueue<CPUJob*>* queue) { // Dequeue and execute every job in the queue, then delete the jobs
+    ExecutionReport* report = new ExecutionReport(cores, memoryBudget);
+
+    int perPriority[11] = {0}; // Number of accepted jobs per priority, used to size the latency arrays
+    int accepted = 0;
+    CPUJob* job;
+    while ((job = queue->dequeue()) != nullptr) { // Distribute jobs round-robin over the cores in queue order
+        if (job->memory_consumed > memoryBudget) { // This job can never fit, so it is rejected up front
+            report->jobsRejected++;
+            queue->releaseJob(job);
+            continue;
+        }
+        int p = (job->priority >= 1 && job->priority <= 10) ? job->priority : 0;
+        perPriority[p]++;
+        ScheduledJob task;
+        task.job = job;
+        task.remaining = job->cpu_time_consumed > 0 ? job->cpu_time_consumed : 0;
+        task.sequence = accepted;
+        task.level = 0;
+        queues[accepted % cores].push(task);
+        accepted++;
+    }
+    for (int p = 0; p < 11; p++) {
+        report->latencies[p] = new long long[perPriority[p] > 0 ? perPriority[p] : 1];
+    }
+
+    ScheduledJob* running = new ScheduledJob[cores]; // Slice currently running on each core
+    bool* busy = new bool[cores]; // Whether each core is running a slice
+    long long* sliceLength = new long long[cores]; // Length of each core's running slice
+    long long* finishTime = new long long[cores]; // Time at which each core's running slice ends
+    for (int c = 0; c < cores; c++) {
+        busy[c] = false;
+        sliceLength[c] = 0;
+        finishTime[c] = 0;
+    }
+
+    long long now = 0; // Current simulated time
+    long long memoryFree = memoryBudget; // Memory not held by running slices
+    int completed = 0;
+    while (completed < accepted) {
+        for (int c = 0; c < cores; c++) { // Hand work to every idle core
+            ScheduledJob task;
+            if (busy[c] || !nextJob(c, task, report)) {
+                continue;
+            }
+            if (task.job->memory_consumed > memoryFree) { // Not enough memory right now, so the core waits with this job next in line
+                queues[c].putBack(task);
+                continue;
+            }
+            memoryFree -= task.job->memory_consumed;
+            running[c] = task;
+            busy[c] = true;
+            sliceLength[c] = queues[c].quantum(task);
+            finishTime[c] = now + sliceLength[c];
+            report->busyTime += sliceLength[c];
+        }
+
+        long long next = -1; // Earliest end of a running slice
+        for (int c = 0; c < cores; c++) {
+            if (busy[c] && (next == -1 || finishTime[c] < next)) {
+                next = finishTime[c];
+            }
+        }
+        if (next == -1) { // Nothing is running and nothing could start (cannot happen once oversized jobs are rejected)
+            break;
+        }
+        now = next;
+        for (int c = 0; c < cores; c++) { // Retire every slice that ends at this time
+            if (!busy[c] || finishTime[c] != now) {
+                continue;
+            }
+            busy[c] = false;
+            memoryFree += running[c].job->memory_consumed;
+            running[c].remaining -= sliceLength[c];
+            if (running[c].remaining > 0) { // Slice ran out before the job finished
+                report->preemptions++;
+                queues[c].preempted(running[c]);
+                continue;
+            }
+            int p = (running[c].job->priority >= 1 && running[c].job->priority <= 10) ? running[c].job->priority : 0;
+            report->latencies[p][report->latencyCounts[p]++] = now;
+            queue->releaseJob(running[c].job);
+            completed++;
+        }
+    }
+
+    report->jobsRun = completed;
+    report->makespan = now;
+    for (int p = 0; p < 11; p++) {
+        sort(report->latencies[p], report->latencies[p] + report->latencyCounts[p]);
+    }
+
+    delete[] running;
+    delete[] busy;
+    delete[] sliceLength;
+    delete[] finishTime;
+    return report;
+}
+
+// Runs the queue through a JobExecutor using the scheduling policy chosen at compile time.
+template <class Policy>
+ExecutionReport* executeWithPolicy(NovelQueue<CPUJob*>* queue, int cores, long long memoryBudget, const long long* weights) {
+    JobExecutor<Policy> executor(cores, memoryBudget, weights);
+    return executor.run(queue);
+}
+
+// One parsed command from the input stream.
+class Command {
+    public:
+        char type; // Command letter (A, R, M, C, P, O, D, N, E, W, L, Q)
+        long long args[6]; // Numeric arguments in input order
+};
+
+// Reads commands from a file descriptor through a large input buffer and parses them in batches.
+// Reads return whatever input is available, so commands arriving on a pipe are processed as they come.
+class CommandReader {
+    public:
+        static const int CAPACITY = 1 << 16; // Bytes read from the input at a time
+        int fd; // Descriptor being parsed (0 for standard input)
+        char* buffer; // Bytes read but not parsed yet
+        int length; // Number of valid bytes in buffer
+        int pos; // Next byte to parse
+        CommandReader(int fd); // Constructor
+        ~CommandReader(); // Destructor
+        bool refill(); // Reads the next block of input, returns false at end of input
+        bool nextChar(char& c); // Skips whitespace and reads one character
+        bool readNumber(long long& value); // Skips whitespace and reads a signed decimal integer
+        int argumentCount(char type); // Number of numeric arguments a command takes
+        int queryArgumentCount(long long kind); // Number of arguments a Q command takes after its query kind
+        int readBatch(Command* commands, int maxCommands); // Parses up to maxCommands commands, returns how many were read
+};
+CommandReader::CommandReader(int fd) { // Constructor
+    (*this).fd = fd;
+    (*this).length = 0;
+    (*this).pos = 0;
+    buffer = new char[CAPACITY];
+}
+CommandReader::~CommandReader() { // Destructor
+    delete[] buffer;
+}
+bool CommandReader::refill() { // Reads the next block of input
+    ssize_t got;
+    do {
+        got = read(fd, buffer, CAPACITY);
+    } while (got < 0 && errno == EINTR);
+    length = got > 0 ? (int)got : 0;
+    pos = 0;
+    return length > 0;
+}
+bool CommandReader::nextChar(char& c) { // Skips whitespace and reads one character
+    while (true) {
+        if (pos == length && !refill()) {
+            return false;
+        }
+        c = buffer[pos++];
+        if (c != ' ' && c != '\n' && c != '\r' && c != '\t') {
+            return true;
+        }
+    }
+}
+bool CommandReader::readNumber(long long& value) { // Skips whitespace and reads a signed decimal integer
+    char c;
+    if (!nextChar(c)) {
+        return false;
+    }
+    bool negative = false;
+    if (c == '-' || c == '+') {
+        negative = (c == '-');
+        if (pos == length && !refill()) {
+            return false;
+        }
+        c = buffer[pos++];
+    }
+    if (c < '0' || c > '9') { // Not a number
+        return false;
+    }
+    value = 0;
+    while (true) {
+        value = value * 10 + (c - '0');
+        if (pos == length && !refill()) {
+            break;
+        }
+        c = buffer[pos];
+        if (c < '0' || c > '9') {
+            break;
+        }
+        pos++;
+    }
+    if (negative) {
+        value = -value;
+    }
+    return true;
+}
+int CommandReader::argumentCount(char type) { // Number of numeric arguments a command takes
+    switch (type) {
+        case 'A': return 5;
+        case 'M': return 5;
+        case 'C': return 3;
+        case 'E': return 3;
+        case 'W': return 2;
+        case 'P': return 2;
+        case 'O': return 1;
+        case 'Q': return 1; // The query kind, which decides how many arguments follow
+        default: return 0; // R, D, N, L and unknown commands
+    }
+}
+int CommandReader::queryArgumentCount(long long kind) { // Number of arguments a Q command takes after its query kind
+    switch (kind) {
+        case 1: return 3; // Range: field low high
+        case 2: return 2; // Top-k: field k
+        case 3: return 1; // Group-by count: field
+        case 4: return 5; // Filtered range: equal_field equal_value range_field low high
+        default: return 0;
+    }
+}
+int CommandReader::readBatch(Command* commands, int maxCommands) { // Parses up to maxCommands commands (fewer if the input has no more yet)
+    int count = 0;
+    while (count < maxCommands) {
+        while (pos < length && (buffer[pos] == ' ' || buffer[pos] == '\n' || buffer[pos] == '\r' || buffer[pos] == '\t')) {
+            pos++;
+        }
+        if (pos == length && count > 0) { // Apply what has arrived instead of waiting for a full batch
+            break;
+        }
+        Command& command = commands[count];
+        if (!nextChar(command.type)) { // End of input
+            break;
+        }
+        int arguments = argumentCount(command.type);
+        bool complete = true;
+        for (int i = 0; i < arguments; i++) {
+            if (!readNumber(command.args[i])) {
+                complete = false;
+                break;
+            }
+            if (i == 0 && command.type == 'Q') {
+                arguments += queryArgumentCount(command.args[0]);
+            }
+        }
+        if (!complete) { // Input ended partway through a command
+            break;
+        }
+        count++;
+    }
+    return count;
+}
+
+// Applies a batch of commands to the queue, writing results to out.
+// In quiet mode only the change made by each command is written (the full queue is only printed for D and L),
+// and runs of consecutive A commands are enqueued together with NovelQueue::enqueueBatch.
+// shareWeights holds the fair-share weight of each FairSharePolicy bucket, set by W commands and used by E.
+void applyCommands(Command* commands, int count, NovelQueue<CPUJob*>* myNovelQueue, long long* shareWeights, OutputBuffer& out, bool quiet) {
+    CPUJob** batchJobs = nullptr; // Scratch space for runs of A commands in quiet mode
+    bool* batchAdded = nullptr;
+    if (quiet) {
+        batchJobs = new CPUJob*[count > 0 ? count : 1];
+        batchAdded = new bool[count > 0 ? count : 1];
+    }
+
+    for (int i = 0; i < count; i++) {
+        Command& command = commands[i];
+        int job_id = (int)command.args[0]; // Every command with arguments that names a job has job_id first
+        // Here we are parsing through the commands to determine which one should be performed based on the command type
+        switch (command.type) {
             case 'A': { // Command to add a new CPUJob to queue (enqueue)
-                cin >> job_id >> priority >> job_type >> cpu_time_consumed >> memory_consumed; // Takes input to initialize new CPUJob object
-                CPUJob* newJob = new CPUJob(job_id, priority, job_type, cpu_time_consumed, memory_consumed); // Creates new CPUJob object from input
+                if (quiet) { // Enqueue the whole run of A commands at once
+                    int runLength = 0;
+                    while (i + runLength < count && commands[i + runLength].type == 'A') {
+                        long long* a = commands[i + runLength].args;
+                        batchJobs[runLength] = myNovelQueue->createJob((int)a[0], (int)a[1], (int)a[2], (int)a[3], (int)a[4]);
+                        runLength++;
+                    }
+                    myNovelQueue->enqueueBatch(batchJobs, runLength, batchAdded);
+                    for (int j = 0; j < runLength; j++) {
+                        if (!batchAdded[j]) { // Job is already within queue (does not get added)
+                            out << "Job ID " << batchJobs[j]->job_id << " already exists!\n";
+                            myNovelQueue->releaseJob(batchJobs[j]);
+                            continue;
+                        }
+                        out << "Enqueued Job: \n";
+                        batchJobs[j]->display(out);
+                    }
+                    i += runLength - 1;
+                    break;
+                }
+                long long* a = command.args;
+                CPUJob* newJob = myNovelQueue->createJob((int)a[0], (int)a[1], (int)a[2], (int)a[3], (int)a[4]); // Creates new CPUJob object from input
                 int jobsAdded = (*myNovelQueue).enqueue(newJob); // Adds this newJob to the queue
                 if (jobsAdded < 1) { // Determine if job is already within queue (does not get added)
-                    cout << "Job ID " << newJob->job_id << " already exists!" << endl;
+                    out << "Job ID " << newJob->job_id << " already exists!\n";
+                    myNovelQueue->releaseJob(newJob); // The duplicate is not kept
                     break;
                 }
-                cout << "Enqueued Job: " << endl;
-                myNovelQueue->NodePtrs[((myNovelQueue->size) - 1)]->JobPointer->display(); // Prints enqueued job
-                
-                cout << "Jobs after enqueue:" << endl;
-                myNovelQueue->display(); // Uses display() method to print all nodes in queue
+                out << "Enqueued Job: \n";
+                newJob->display(out); // Prints enqueued job
+                out << "Jobs after enqueue:\n";
+                myNovelQueue->display(out); // Prints all nodes in queue
                 break; // End case
             }
             case 'R': { // Command to remove a CPUJob from queue (dequeue)
                 CPUJob* removedJob = (*myNovelQueue).dequeue(); // Create placeholder for dequeue'd job
                 if (removedJob) { // Determines whether dequeue() returns anything
-                    cout << "Dequeued Job: " << endl;
-                    (*removedJob).display(); // Prints removedJob
-                    delete removedJob; // Deletes removedJob to free up memory
+                    out << "Dequeued Job: \n";
+                    (*removedJob).display(out); // Prints removedJob
+                    myNovelQueue->releaseJob(removedJob); // Returns removedJob to the job pool
+                }
+                if (!quiet) {
+                    out << "Jobs after dequeue:\n";
+                    myNovelQueue->display(out); // Prints all nodes in queue
                 }
-                cout << "Jobs after dequeue:" << endl;
-                myNovelQueue->display(); // Uses display() method to print all nodes in queue
                 break; // End case
             }
             case 'M': {
-                cin >> job_id >> priority >> job_type >> cpu_time_consumed >> memory_consumed; // Takes input to modify a CPUJob object
-                int pos = myNovelQueue->modify(job_id, priority, job_type, cpu_time_consumed, memory_consumed); // Changes job's priority, job_type, cpu_time_consumed, and memory_consumed. Returns index within queue
-                cout << "Modified Job ID " << job_id << ":" << endl;
-                myNovelQueue->NodePtrs[pos]->JobPointer->display(); // Print modified job
-                cout << "Jobs after modification:" << endl;
-                myNovelQueue->display(); // Uses display() method to print all nodes in queue
+                long long* a = command.args;
+                int pos = myNovelQueue->modify(job_id, (int)a[1], (int)a[2], (int)a[3], (int)a[4]); // Changes job's priority, job_type, cpu_time_consumed, and memory_consumed. Returns index within queue
+                if (pos == -1) { // Determine if job was found within queue
+                    out << "Job with ID " << job_id << " not found in the queue.\n";
+                    break;
+                }
+                out << "Modified Job ID " << job_id << ":\n";
+                myNovelQueue->jobAt(pos)->display(out); // Print modified job
+                if (!quiet) {
+                    out << "Jobs after modification:\n";
+                    myNovelQueue->display(out); // Prints all nodes in queue
+                }
                 break;
             }
             case 'C': {
-                cin >> job_id >> field_index >> new_value; // Takes input to modify a specific field of a CPUJob object
+                int field_index = (int)command.args[1];
+                int new_value = (int)command.args[2];
                 int pos = myNovelQueue->change(job_id, field_index, new_value); // Changes job's field_index with new_value and returns index within queue
                 if (pos == -1) { // Determine if job was found within queue
-                    cout << "Job with ID " << job_id << " not found in the queue." << endl;
+                    out << "Job with ID " << job_id << " not found in the queue.\n";
                     break;
                 }
-                cout << "Changed Job ID " << job_id << " field " << field_index << " to " << new_value << ":" << endl;
-                myNovelQueue->NodePtrs[pos]->JobPointer->display(); // Print changed job
-                cout << "Jobs after changing field:" << endl;
-                myNovelQueue->display(); // Uses display() method to print all nodes in queue
+                out << "Changed Job ID " << job_id << " field " << field_index << " to " << new_value << ":\n";
+                myNovelQueue->jobAt(pos)->display(out); // Print changed job
+                if (!quiet) {
+                    out << "Jobs after changing field:\n";
+                    myNovelQueue->display(out); // Prints all nodes in queue
+                }
                 break;
             }
             case 'P': {
-                cin >> job_id >> positions; // Takes input to promote a certain job within the queue
+                int positions = (int)command.args[1];
                 int pos = myNovelQueue->promote(job_id, positions); // Promotes job within queue and returns index of job
-                if (pos != -1) { // Determines if job was actually found within queue
-                    cout << "Promoted Job ID " << job_id << " by " << positions << " Position(s):" << endl;
-                    myNovelQueue->NodePtrs[pos]->JobPointer->display(); // Print promoted job
-                    cout << "Jobs after promotion:" << endl;
-                    myNovelQueue->display(); // Uses display() method to print all nodes in queue
+                if (pos == -1) { // If job not found do nothing
                     break;
                 }
-                else { // If job not found do nothing
-                    break;
+                out << "Promoted Job ID " << job_id << " by " << positions << " Position(s):\n";
+                myNovelQueue->jobAt(pos)->display(out); // Print promoted job
+                if (!quiet) {
+                    out << "Jobs after promotion:\n";
+                    myNovelQueue->display(out); // Prints all nodes in queue
                 }
+                break;
             }
             case 'O': {
-                cin >> attribute_index; // Takes input to determine which field to reorder the queue by
+                int attribute_index = (int)command.args[0];
                 myNovelQueue->reorder(attribute_index); // Reorders queue nodes based on attribute index
-                cout << "Reordered Queue by attribute " << attribute_index << ":" << endl;
-                myNovelQueue->display(); // Uses display() method to print all nodes in queue
+                out << "Reordered Queue by attribute " << attribute_index << ":\n";
+                if (!quiet) {
+                    myNovelQueue->display(out); // Prints all nodes in queue
+                }
                 break;
             }
             case 'D': { // Displays all jobs within queue
-                cout << "Displaying all jobs in the queue:" << endl;
-                myNovelQueue->display(); // Uses display() method to print all nodes in queue
+                out << "Displaying all jobs in the queue:\n";
+                myNovelQueue->display(out); // Prints all nodes in queue
                 break;
             }
             case 'N': { // Prints number of nodes in the queue
-                int size = myNovelQueue->count(); // Grabs amount of nodes in queue
-                cout << "Number of elements in the queue: " << size << endl;
+                out << "Number of elements in the queue: " << myNovelQueue->count() << "\n";
+                break;
+            }
+            case 'E': { // Executes every job in the queue on a number of simulated cores
+                int cores = (int)command.args[0]; // Number of cores to simulate
+                long long memoryBudget = command.args[1]; // Global memory budget shared by running jobs
+                int policy = (int)command.args[2]; // Scheduling policy (1 = FIFO, 2 = SJF, 3 = MLFQ, 4 = fair share by job_type, weighted by W commands)
+                ExecutionReport* report;
+                switch (policy) { // Each policy is its own JobExecutor instantiation
+                    case 2: {
+                        report = executeWithPolicy<SJFPolicy>(myNovelQueue, cores, memoryBudget, nullptr);
+                        break;
+                    }
+                    case 3: {
+                        report = executeWithPolicy<MLFQPolicy>(myNovelQueue, cores, memoryBudget, nullptr);
+                        break;
+                    }
+                    case 4: {
+                        report = executeWithPolicy<FairSharePolicy>(myNovelQueue, cores, memoryBudget, shareWeights);
+                        break;
+                    }
+                    default: {
+                        policy = 1;
+                        report = executeWithPolicy<FifoPolicy>(myNovelQueue, cores, memoryBudget, nullptr);
+                        break;
+                    }
+                }
+                out << "Executed all jobs in the queue with policy " << policy << ":\n";
+                report->display(out); // Prints makespan, utilization and latency percentiles
+                delete report;
+                break;
+            }
+            case 'W': { // Sets the share of a job_type for later fair-share E commands
+                int job_type = (int)command.args[0];
+                long long weight = command.args[1];
+                int bucket = (job_type >= 1 && job_type < FairSharePolicy::BUCKETS) ? job_type : 0; // Same buckets as FairSharePolicy
+                shareWeights[bucket] = weight > 0 ? weight : 1;
+                out << "Fair-share weight of job type " << job_type << " set to " << shareWeights[bucket] << "\n";
                 break;
             }
             case 'L': { // Lists jobs sorted by job IDs
                 myNovelQueue->reorder(1); // Reorders queue based on field 1 (job_ID)
-                cout << "List of jobs sorted by job IDs:" << endl;
-                myNovelQueue->display(); // Uses display() method to print all nodes in queue
+                out << "List of jobs sorted by job IDs:\n";
+                myNovelQueue->display(out); // Prints all nodes in queue
+                break;
+            }
+            case 'Q': { // Answers a query from the secondary indexes without touching queue order
+                long long* a = command.args;
+                int kind = (int)a[0];
+                int found = 0;
+                auto show = [&out](CPUJob* job) { job->display(out); };
+                switch (kind) {
+                    case 1: { // Jobs whose field lies in [low, high]
+                        out << "Jobs with field " << (int)a[1] << " between " << (int)a[2] << " and " << (int)a[3] << ":\n";
+                        found = myNovelQueue->queryRange((int)a[1], (int)a[2], (int)a[3], show);
+                        break;
+                    }
+                    case 2: { // The k largest values of a field
+                        out << "Top " << (int)a[2] << " jobs by field " << (int)a[1] << ":\n";
+                        found = myNovelQueue->queryTop((int)a[1], (int)a[2], show);
+                        break;
+                    }
+                    case 3: { // Number of jobs per distinct value of a field
+                        out << "Job counts by field " << (int)a[1] << ":\n";
+                        found = myNovelQueue->queryGroupCount((int)a[1], [&out](int value, int count) {
+                            out << "Value: " << value << ", Jobs: " << count << "\n";
+                        });
+                        break;
+                    }
+                    case 4: { // Jobs whose field equals a value and whose other field lies in [low, high]
+                        out << "Jobs with field " << (int)a[1] << " equal to " << (int)a[2] << " and field " << (int)a[3] << " between " << (int)a[4] << " and " << (int)a[5] << ":\n";
+                        found = myNovelQueue->queryRangeWhere((int)a[1], (int)a[2], (int)a[3], (int)a[4], (int)a[5], show);
+                        break;
+                    }
+                    default: {
+                        out << "Invalid query\n";
+                        found = -1;
+                        break;
+                    }
+                }
+                if (found >= 0) {
+                    out << "Query returned " << found << (kind == 3 ? " groups\n" : " jobs\n");
+                }
+                else if (kind == 4) {
+                    out << "Unsupported query\n";
+                }
                 break;
             }
             default: // Default case for undefined commands
-                cout << "Invalid command" << endl;
+                out << "Invalid command\n";
+        }
+    }
+
+    delete[] batchJobs;
+    delete[] batchAdded;
+}
+
+// Draws ranks 1..n with probability proportional to 1 / rank^exponent, using a cumulative table and binary search.
+class ZipfSampler {
+    public:
+        double* cumulative; // cumulative[i] = P(rank <= i + 1)
+        int n; // Number of ranks
+        ZipfSampler(int n, double exponent); // Constructor
+        ~ZipfSampler(); // Destructor
+        int sample(mt19937& random); // Returns a rank between 1 and n
+};
+ZipfSampler::ZipfSampler(int n, double exponent) { // Constructor
+    (*this).n = n;
+    cumulative = new double[n];
+    double total = 0;
+    for (int i = 0; i < n; i++) {
+        total += 1.0 / pow(i + 1.0, exponent);
+        cumulative[i] = total;
+    }
+    for (int i = 0; i < n; i++) { // Normalize so the last entry is 1
+        cumulative[i] /= total;
+    }
+}
+ZipfSampler::~ZipfSampler() { // Destructor
+    delete[] cumulative;
+}
+int ZipfSampler::sample(mt19937& random) { // Returns a rank between 1 and n
+    double u = uniform_real_distribution<double>(0.0, 1.0)(random);
+    int rank = (int)(upper_bound(cumulative, cumulative + n, u) - cumulative) + 1;
+    return rank > n ? n : rank;
+}
+
+// Writes a synthetic scheduler trace in the normal command format (first line is the number of commands).
+// Arrivals come in bursts: the generator alternates between busy periods, where most commands are A, and quiet periods,
+// where dequeues catch up. New jobs get increasing job_ids. M, C and P commands pick their job_id with a Zipf distribution
+// over recent arrivals, so a few recent jobs get most of the changes (and some targets have already been dequeued).
+void generateTrace(long long count, unsigned int seed, OutputBuffer& out) {
+    mt19937 random(seed);
+    uniform_real_distribution<double> coin(0.0, 1.0);
+    ZipfSampler recentJobs(4096, 1.1); // Popularity of the 4096 most recent arrivals
+    int nextJobId = 1;
+    bool burst = false; // Whether arrivals are currently bursting
+    long long phaseLeft = 0; // Commands left in the current phase
+
+    out << count << "\n";
+    for (long long i = 0; i < count; i++) {
+        if (phaseLeft == 0) { // Switch between bursts and quiet periods of random length
+            burst = !burst;
+            phaseLeft = 1 + (long long)(-log(1.0 - coin(random)) * (burst ? 200 : 400));
+        }
+        phaseLeft--;
+        double arrivalRate = burst ? 0.85 : 0.30; // Share of A commands in this phase
+        double roll = coin(random);
+        if (roll < arrivalRate || nextJobId == 1) { // Arrival
+            out << "A " << nextJobId++ << " " << (int)(1 + coin(random) * 10) << " " << (int)(1 + coin(random) * 10) << " "
+                << (int)(10 + coin(random) * 990) << " " << (int)(256 + coin(random) * 16128) << "\n";
+            continue;
+        }
+        roll = (roll - arrivalRate) / (1.0 - arrivalRate); // Spread the rest over the other commands
+        int target = nextJobId - recentJobs.sample(random);
+        if (target < 1) {
+            target = 1;
+        }
+        if (roll < 0.45) {
+            out << "R\n";
+        }
+        else if (roll < 0.60) {
+            out << "M " << target << " " << (int)(1 + coin(random) * 10) << " " << (int)(1 + coin(random) * 10) << " "
+                << (int)(10 + coin(random) * 990) << " " << (int)(256 + coin(random) * 16128) << "\n";
+        }
+        else if (roll < 0.80) {
+            out << "C " << target << " " << (int)(1 + coin(random) * 4) << " " << (int)(1 + coin(random) * 10) << "\n";
+        }
+        else if (roll < 0.9995) {
+            out << "P " << target << " " << (int)(1 + coin(random) * 100) << "\n";
+        }
+        else {
+            out << "O " << (int)(1 + coin(random) * 5) << "\n";
+        }
+    }
+}
+
+// Replays commands against a NovelQueue without producing their normal output and reports, per command type,
+// latency percentiles (p50/p99/p999) and heap allocations per operation. Only the queue work is timed, not parsing or output.
+void benchmarkCommands(Command* commands, int count, OutputBuffer& out) {
+    NovelQueue<CPUJob*>* queue = new NovelQueue<CPUJob*>();
+    const char* types = "ARMCPODNL"; // Command types that are measured
+    const int TYPES = 9;
+    long long* samples[TYPES]; // Latency of every command of each type, in nanoseconds
+    int sampleCounts[TYPES];
+    long long allocations[TYPES]; // Total heap allocations made by each command type
+    for (int t = 0; t < TYPES; t++) {
+        samples[t] = new long long[count > 0 ? count : 1];
+        sampleCounts[t] = 0;
+        allocations[t] = 0;
+    }
+
+    for (int i = 0; i < count; i++) {
+        Command& command = commands[i];
+        int t = 0;
+        while (t < TYPES && types[t] != command.type) {
+            t++;
+        }
+        if (t == TYPES) { // Invalid and executor commands are not part of the benchmark
+            continue;
+        }
+        long long* a = command.args;
+        long long allocationsBefore = allocationCount;
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        switch (command.type) {
+            case 'A': {
+                CPUJob* job = queue->createJob((int)a[0], (int)a[1], (int)a[2], (int)a[3], (int)a[4]);
+                if (queue->enqueue(job) < 1) {
+                    queue->releaseJob(job);
+                }
+                break;
+            }
+            case 'R': {
+                queue->releaseJob(queue->dequeue());
+                break;
+            }
+            case 'M': queue->modify((int)a[0], (int)a[1], (int)a[2], (int)a[3], (int)a[4]); break;
+            case 'C': queue->change((int)a[0], (int)a[1], (int)a[2]); break;
+            case 'P': queue->promote((int)a[0], (int)a[1]); break;
+            case 'O': queue->reorder((int)a[0]); break;
+            case 'D': queue->jobAt(0); break;
+            case 'N': queue->count(); break;
+            case 'L': queue->reorder(1); break;
+        }
+        chrono::steady_clock::time_point end = chrono::steady_clock::now();
+        samples[t][sampleCounts[t]++] = chrono::duration_cast<chrono::nanoseconds>(end - start).count();
+        allocations[t] += allocationCount - allocationsBefore;
+    }
+
+    out << "Replayed " << count << " command(s), final queue size " << queue->count() << "\n";
+    out << "Op  Count      p50(ns)    p99(ns)    p999(ns)   max(ns)    allocs/op\n";
+    for (int t = 0; t < TYPES; t++) {
+        int n = sampleCounts[t];
+        if (n == 0) {
+            continue;
+        }
+        sort(samples[t], samples[t] + n);
+        long long percentiles[4] = {samples[t][(n - 1) * 50 / 100], samples[t][(n - 1) * 99 / 100], samples[t][(long long)(n - 1) * 999 / 1000], samples[t][n - 1]};
+        char line[160];
+        snprintf(line, sizeof(line), "%c   %-10d %-10lld %-10lld %-10lld %-10lld %.3f\n", types[t], n, percentiles[0], percentiles[1], percentiles[2], percentiles[3], (double)allocations[t] / n);
+        out << line;
+    }
+
+    for (int t = 0; t < TYPES; t++) {
+        delete[] samples[t];
+    }
+    delete queue;
+}
+
+// Main program for organizing and manipulating input for proper output.
+// Usage: project3 [--quiet] < commands.txt
+//        project3 --generate-trace <commands> [seed] > trace.txt
+//        project3 --benchmark < trace.txt
+//     --quiet            Only print what each command changed instead of the whole queue after every command
+//     --generate-trace   Write a synthetic trace of bursty arrivals and Zipf-distributed changes
+//     --benchmark        Replay commands and report per-operation latency percentiles and allocations
+//     --persist <dir>    Recover the queue from <dir> on start and log every change there (snapshot taken on exit
+//                        and every SNAPSHOT_RECORDS logged changes)
+int main(int argc, char* argv[]) {
+    bool quiet = false;
+    bool benchmark = false;
+    string persistDirectory; // Empty when the queue is not persisted
+    const long long SNAPSHOT_RECORDS = 1000000; // Logged changes between automatic snapshots
+    OutputBuffer out(cout); // All output goes through one reusable buffer
+    for (int i = 1; i < argc; i++) {
+        string flag = argv[i];
+        if (flag == "--quiet") {
+            quiet = true;
+        }
+        else if (flag == "--benchmark") {
+            benchmark = true;
+        }
+        else if (flag == "--persist" && i + 1 < argc) {
+            persistDirectory = argv[++i];
+        }
+        else if (flag == "--generate-trace" && i + 1 < argc) {
+            long long count = atoll(argv[i + 1]);
+            unsigned int seed = i + 2 < argc ? (unsigned int)atoll(argv[i + 2]) : 2413;
+            generateTrace(count, seed, out);
+            return 0;
+        }
+    }
+
+    CommandReader reader(0); // Buffered command parser over standard input
+    long long n = 0; // Number of commands
+    reader.readNumber(n); // Read in the number of commands
+
+    if (benchmark) { // Parse the whole trace first so only queue operations are timed
+        Command* trace = new Command[n > 0 ? n : 1];
+        int count = 0;
+        while (count < n) { // readBatch stops early whenever the buffered input runs out
+            int read = reader.readBatch(trace + count, (int)(n - count));
+            if (read == 0) { // Input ended early
+                break;
+            }
+            count += read;
+        }
+        benchmarkCommands(trace, count, out);
+        delete[] trace;
+        return 0;
+    }
+
+    NovelQueue<CPUJob*>* myNovelQueue = new NovelQueue<CPUJob*>(); // Instantiate a NovelQueue for CPUJob pointers
+    QueueLog* journal = nullptr;
+    if (!persistDirectory.empty()) { // Restore the previous state before applying new commands
+        journal = new QueueLog(persistDirectory);
+        long long replayed = recoverQueue(myNovelQueue, journal);
+        cerr << "Recovered " << myNovelQueue->count() << " job(s), replayed " << replayed << " log record(s)" << endl;
+    }
+
+    long long shareWeights[FairSharePolicy::BUCKETS]; // Fair-share weight of each job_type, changed by W commands
+    for (int i = 0; i < FairSharePolicy::BUCKETS; i++) {
+        shareWeights[i] = 1;
+    }
+
+    const int BATCH_SIZE = 4096; // Commands parsed and applied at a time
+    Command* commands = new Command[BATCH_SIZE];
+    long long processed = 0;
+    while (processed < n) { // Parse a batch, then apply it
+        int wanted = n - processed < BATCH_SIZE ? (int)(n - processed) : BATCH_SIZE;
+        int count = reader.readBatch(commands, wanted);
+        if (count == 0) { // Input ended early
+            break;
+        }
+        applyCommands(commands, count, myNovelQueue, shareWeights, out, quiet);
+        processed += count;
+        if (journal) { // Group commit: one sync per batch of commands
+            journal->commit();
+            if (journal->recordsSinceSnapshot >= SNAPSHOT_RECORDS) {
+                saveSnapshot(myNovelQueue, journal);
+            }
+        }
+    }
+
+    if (journal) { // Snapshot on exit (if anything changed) so the next start does not need to replay the log
+        if (journal->recordsSinceSnapshot > 0) {
+            saveSnapshot(myNovelQueue, journal);
         }
+        delete journal;
     }
 
+    out.flush();
+    delete[] commands;
     delete myNovelQueue; // Delete NovelQueue after program completion
 
     return 0; // End program
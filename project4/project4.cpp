@@ -6,6 +6,30 @@ array recursively and using the split values for tree navigation.
 
 #include <iostream>
 #include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <cstring>
+#include <type_traits>
+#include <unordered_map>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <cmath>
+#include <cfloat>
+#include <cstdio>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 using namespace std;
 
 class NotFoundException { // Exception thrown when tasked to remove a value, but it is not found.
@@ -15,239 +39,2637 @@ class NotFoundException { // Exception thrown when tasked to remove a value, but
         }
 };
 
+class DiskIOException { // Exception thrown when an index file cannot be read, written or recognised.
+    public:
+        const char* message; // What went wrong
+        DiskIOException(const char* message) : message(message) {
+        }
+        const char* what() const {
+            return message;
+        }
+};
+
+// Read-only copy of a tree's values packed into one cache-line-aligned arena. Each block holds KEYS sorted keys (one
+// 64 byte line for int) and the blocks form a static (KEYS + 1)-ary search tree in Eytzinger order: the children of block k
+// are blocks k * (KEYS + 1) + 1 ... k * (KEYS + 1) + KEYS + 1. Children are found by arithmetic instead of pointers,
+// so a lookup reads one cache line per level and the next line's address is known as soon as the compare is done.
+// This is only a read-only copy: the MTree nodes themselves still keep their values and children in vectors, since
+// inserts and removes splice them in place. A read-mostly tree answers find from here, see MTree::find.
+template <class DT>
+class FlatMTree {
+    public:
+        static const int LINE = 64; // Cache line size in bytes
+        static const int KEYS = sizeof(DT) >= LINE ? 1 : LINE / sizeof(DT); // Keys per block
+        DT* keys; // Arena of blocks * KEYS keys, block k starts at keys + k * KEYS
+        int blocks; // Number of blocks
+        FlatMTree(const vector<DT>& sorted); // Packs sorted, distinct values
+        ~FlatMTree(); // Destructor
+        void fill_block(int k, const vector<DT>& sorted, int& next); // Fills block k and its subtrees in order from sorted[next...]
+        bool contains(const DT& value) const; // Determine if a value is within the copy
+};
+template <class DT>
+FlatMTree<DT>::FlatMTree(const vector<DT>& sorted) { // Packs sorted, distinct values
+    blocks = (sorted.size() + KEYS - 1) / KEYS;
+    keys = nullptr;
+    if (blocks == 0) {
+        return;
+    }
+    void* memory;
+    if (posix_memalign(&memory, LINE, (size_t)blocks * KEYS * sizeof(DT)) != 0) {
+        throw bad_alloc();
+    }
+    keys = (DT*)memory;
+    int next = 0;
+    fill_block(0, sorted, next);
+}
+template <class DT>
+FlatMTree<DT>::~FlatMTree() { // Destructor
+    for (int i = 0; i < blocks * KEYS; i++) {
+        keys[i].~DT();
+    }
+    free(keys);
+}
+template <class DT>
+void FlatMTree<DT>::fill_block(int k, const vector<DT>& sorted, int& next) { // In-order walk of the implicit tree
+    if (k >= blocks) {
+        return;
+    }
+    for (int j = 0; j < KEYS; j++) {
+        fill_block(k * (KEYS + 1) + j + 1, sorted, next); // Everything left of key j
+        // Unused slots repeat the largest value, which keeps every block sorted and can only ever match that value
+        new (&keys[k * KEYS + j]) DT(next < (int)sorted.size() ? sorted[next++] : sorted.back());
+    }
+    fill_block(k * (KEYS + 1) + KEYS + 1, sorted, next);
+}
+template <class DT>
+bool FlatMTree<DT>::contains(const DT& value) const { // Determine if a value is within the copy
+    const DT* candidate = nullptr; // Smallest key >= value seen so far
+    int k = 0;
+    while (k < blocks) {
+        const DT* block = keys + k * KEYS;
+        int j = 0;
+        for (int i = 0; i < KEYS; i++) { // Count the keys below value without branching (vectorizes for int)
+            j += (block[i] < value);
+        }
+        if (j < KEYS) {
+            candidate = block + j;
+        }
+        k = k * (KEYS + 1) + j + 1;
+    }
+    return candidate && !(value < *candidate);
+}
+
+// Compressed read-only copy of a tree's keys, used instead of FlatMTree when the tree is set to compressed mode. Key types
+// without a compressed form are simply packed uncompressed.
+template <class DT, bool Integral = is_integral<DT>::value>
+class CompressedKeys {
+    public:
+        FlatMTree<DT> keys; // Uncompressed packed keys
+        CompressedKeys(const vector<DT>& sorted); // Packs sorted, distinct values
+        bool contains(const DT& value) const; // Determine if a value is within the copy
+};
+template <class DT, bool Integral>
+CompressedKeys<DT, Integral>::CompressedKeys(const vector<DT>& sorted) : keys(sorted) { // Packs sorted, distinct values
+}
+template <class DT, bool Integral>
+bool CompressedKeys<DT, Integral>::contains(const DT& value) const { // Determine if a value is within the copy
+    return keys.contains(value);
+}
+
+// Integer keys use frame-of-reference blocks: each block of BLOCK keys keeps its first key in full and stores every key as
+// its distance from that first key, in 2, 4 or 8 bytes depending on the block's span. Dense keys take 2 bytes each instead
+// of 4 or 8. A lookup binary searches the first keys and then compares the target distance against the whole block at
+// once (SSE2 where available), so there is nothing to decode one key at a time.
+template <class DT>
+class CompressedKeys<DT, true> {
+    public:
+        static const int BLOCK = 32; // Keys per block (unused slots repeat the block's last distance)
+        int n; // Number of keys
+        int blocks; // Number of blocks
+        DT* firsts; // First key of each block
+        unsigned char* widths; // Bytes per distance in each block
+        unsigned int* offsets; // Byte offset of each block's distances in arena
+        unsigned char* arena; // Distances, 16 byte aligned
+        CompressedKeys(const vector<DT>& sorted); // Packs sorted, distinct values
+        ~CompressedKeys(); // Destructor
+        bool contains(const DT& value) const; // Determine if a value is within the copy
+        int block_for(const DT& value) const; // Last block whose first key is <= value (-1 if none)
+};
+template <class DT>
+const int CompressedKeys<DT, true>::BLOCK;
+template <class DT>
+CompressedKeys<DT, true>::CompressedKeys(const vector<DT>& sorted) { // Packs sorted, distinct values
+    n = sorted.size();
+    blocks = (n + BLOCK - 1) / BLOCK;
+    firsts = new DT[blocks > 0 ? blocks : 1];
+    widths = new unsigned char[blocks > 0 ? blocks : 1];
+    offsets = new unsigned int[blocks > 0 ? blocks : 1];
+    size_t total = 0;
+    for (int b = 0; b < blocks; b++) { // Pick each block's width first so the arena can be sized exactly
+        int start = b * BLOCK;
+        int last = min(n, start + BLOCK) - 1;
+        unsigned long long span = (unsigned long long)sorted[last] - (unsigned long long)sorted[start];
+        firsts[b] = sorted[start];
+        widths[b] = span <= 0xFFFFull ? 2 : (span <= 0xFFFFFFFFull ? 4 : 8);
+        offsets[b] = total;
+        total += (size_t)BLOCK * widths[b];
+    }
+    void* memory = nullptr;
+    if (posix_memalign(&memory, 16, total > 0 ? total : 16) != 0) {
+        throw bad_alloc();
+    }
+    arena = (unsigned char*)memory;
+    for (int b = 0; b < blocks; b++) {
+        int start = b * BLOCK;
+        int count = min(n - start, BLOCK);
+        for (int i = 0; i < BLOCK; i++) {
+            unsigned long long distance = (unsigned long long)sorted[start + min(i, count - 1)] - (unsigned long long)firsts[b];
+            unsigned char* slot = arena + offsets[b] + (size_t)i * widths[b];
+            if (widths[b] == 2) {
+                unsigned short d = distance;
+                memcpy(slot, &d, 2);
+            }
+            else if (widths[b] == 4) {
+                unsigned int d = distance;
+                memcpy(slot, &d, 4);
+            }
+            else {
+                memcpy(slot, &distance, 8);
+            }
+        }
+    }
+}
+template <class DT>
+CompressedKeys<DT, true>::~CompressedKeys() { // Destructor
+    delete[] firsts;
+    delete[] widths;
+    delete[] offsets;
+    free(arena);
+}
 template <class DT>
+int CompressedKeys<DT, true>::block_for(const DT& value) const { // Last block whose first key is <= value
+    if (blocks == 0) {
+        return -1;
+    }
+    const DT* base = firsts; // Same branch-free halving as MTree::count_not_greater
+    int m = blocks;
+    while (m > 1) {
+        int half = m / 2;
+        base = (value < base[half]) ? base : base + half;
+        m -= half;
+    }
+    return (base - firsts) - (value < *base);
+}
+template <class DT>
+bool CompressedKeys<DT, true>::contains(const DT& value) const { // Determine if a value is within the copy
+    int b = block_for(value);
+    if (b < 0) {
+        return false;
+    }
+    unsigned long long distance = (unsigned long long)value - (unsigned long long)firsts[b];
+    const unsigned char* block = arena + offsets[b];
+    if (widths[b] == 2) {
+        if (distance > 0xFFFFull) {
+            return false;
+        }
+#ifdef __SSE2__
+        __m128i target = _mm_set1_epi16((short)distance);
+        __m128i hits = _mm_setzero_si128();
+        for (int i = 0; i < BLOCK * 2; i += 16) {
+            hits = _mm_or_si128(hits, _mm_cmpeq_epi16(_mm_load_si128((const __m128i*)(block + i)), target));
+        }
+        return _mm_movemask_epi8(hits) != 0;
+#else
+        const unsigned short* d = (const unsigned short*)block;
+        bool found = false;
+        for (int i = 0; i < BLOCK; i++) {
+            found |= (d[i] == distance);
+        }
+        return found;
+#endif
+    }
+    if (widths[b] == 4) {
+        if (distance > 0xFFFFFFFFull) {
+            return false;
+        }
+#ifdef __SSE2__
+        __m128i target = _mm_set1_epi32((int)distance);
+        __m128i hits = _mm_setzero_si128();
+        for (int i = 0; i < BLOCK * 4; i += 16) {
+            hits = _mm_or_si128(hits, _mm_cmpeq_epi32(_mm_load_si128((const __m128i*)(block + i)), target));
+        }
+        return _mm_movemask_epi8(hits) != 0;
+#else
+        const unsigned int* d = (const unsigned int*)block;
+        bool found = false;
+        for (int i = 0; i < BLOCK; i++) {
+            found |= (d[i] == distance);
+        }
+        return found;
+#endif
+    }
+    const unsigned long long* d = (const unsigned long long*)block;
+    bool found = false;
+    for (int i = 0; i < BLOCK; i++) {
+        found |= (d[i] == distance);
+    }
+    return found;
+}
+
+// String keys use front coding: each block of BLOCK keys stores its first key in full and every later key as the length
+// of the prefix it shares with the key before it plus the rest of its bytes. Sorted keys tend to share long prefixes, so
+// most of those bytes disappear. A lookup binary searches the blocks by their first keys and then rebuilds the keys of
+// one block in order, stopping as soon as it passes the target.
+template <>
+class CompressedKeys<string, false> {
+    public:
+        static const int BLOCK = 16; // Keys per block
+        int n; // Number of keys
+        int blocks; // Number of blocks
+        unsigned int* starts; // Byte offset of each block in arena
+        string arena; // Encoded blocks: lengths are LEB128 varints
+        CompressedKeys(const vector<string>& sorted); // Packs sorted, distinct values
+        ~CompressedKeys(); // Destructor
+        static void put_varint(string& out, unsigned int x); // Appends x as a LEB128 varint
+        unsigned int get_varint(unsigned int& pos) const; // Reads a LEB128 varint at pos
+        int compare_first(int b, const string& value) const; // Compares block b's first key with value (<0, 0, >0)
+        bool contains(const string& value) const; // Determine if a value is within the copy
+};
+const int CompressedKeys<string, false>::BLOCK;
+CompressedKeys<string, false>::CompressedKeys(const vector<string>& sorted) { // Packs sorted, distinct values
+    n = sorted.size();
+    blocks = (n + BLOCK - 1) / BLOCK;
+    starts = new unsigned int[blocks > 0 ? blocks : 1];
+    for (int i = 0; i < n; i++) {
+        if (i % BLOCK == 0) { // First key of a block, stored in full
+            starts[i / BLOCK] = arena.size();
+            put_varint(arena, sorted[i].size());
+            arena += sorted[i];
+            continue;
+        }
+        const string& before = sorted[i - 1];
+        unsigned int shared = 0;
+        while (shared < before.size() && shared < sorted[i].size() && before[shared] == sorted[i][shared]) {
+            shared++;
+        }
+        put_varint(arena, shared);
+        put_varint(arena, sorted[i].size() - shared);
+        arena.append(sorted[i], shared, string::npos);
+    }
+}
+CompressedKeys<string, false>::~CompressedKeys() { // Destructor
+    delete[] starts;
+}
+void CompressedKeys<string, false>::put_varint(string& out, unsigned int x) { // Appends x as a LEB128 varint
+    while (x >= 0x80) {
+        out += (char)(x | 0x80);
+        x >>= 7;
+    }
+    out += (char)x;
+}
+unsigned int CompressedKeys<string, false>::get_varint(unsigned int& pos) const { // Reads a LEB128 varint at pos
+    unsigned int x = 0;
+    int shift = 0;
+    while (true) {
+        unsigned char byte = arena[pos++];
+        x |= (unsigned int)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return x;
+        }
+        shift += 7;
+    }
+}
+int CompressedKeys<string, false>::compare_first(int b, const string& value) const { // Compares block b's first key with value
+    unsigned int pos = starts[b];
+    unsigned int length = get_varint(pos);
+    return arena.compare(pos, length, value);
+}
+bool CompressedKeys<string, false>::contains(const string& value) const { // Determine if a value is within the copy
+    int low = 0; // Find the last block whose first key is <= value
+    int high = blocks - 1;
+    int b = -1;
+    while (low <= high) {
+        int mid = (low + high) / 2;
+        int c = compare_first(mid, value);
+        if (c == 0) {
+            return true;
+        }
+        if (c < 0) {
+            b = mid;
+            low = mid + 1;
+        }
+        else {
+            high = mid - 1;
+        }
+    }
+    if (b < 0) {
+        return false;
+    }
+    unsigned int pos = starts[b];
+    unsigned int length = get_varint(pos);
+    string key = arena.substr(pos, length); // Key being rebuilt
+    pos += length;
+    int count = min(n - b * BLOCK, BLOCK);
+    for (int i = 1; i < count; i++) {
+        unsigned int shared = get_varint(pos);
+        unsigned int rest = get_varint(pos);
+        key.resize(shared);
+        key.append(arena, pos, rest);
+        pos += rest;
+        int c = key.compare(value);
+        if (c >= 0) { // Keys only grow from here on
+            return c == 0;
+        }
+    }
+    return false;
+}
+
+// Frozen snapshot of a tree's keys for build-once, query-forever use, used instead of FlatMTree when the tree is set to
+// frozen mode. Key types that are not numbers have no model to fit and are simply packed as in FlatMTree.
+template <class DT, bool Arithmetic = is_arithmetic<DT>::value>
+class FrozenMTree {
+    public:
+        FlatMTree<DT> keys; // Packed keys
+        FrozenMTree(const vector<DT>& sorted); // Packs sorted, distinct values
+        bool contains(const DT& value) const; // Determine if a value is within the copy
+        size_t memory_usage() const; // Heap bytes held by the copy
+};
+template <class DT, bool Arithmetic>
+FrozenMTree<DT, Arithmetic>::FrozenMTree(const vector<DT>& sorted) : keys(sorted) { // Packs sorted, distinct values
+}
+template <class DT, bool Arithmetic>
+bool FrozenMTree<DT, Arithmetic>::contains(const DT& value) const { // Determine if a value is within the copy
+    return keys.contains(value);
+}
+template <class DT, bool Arithmetic>
+size_t FrozenMTree<DT, Arithmetic>::memory_usage() const { // Heap bytes held by the copy
+    return (size_t)keys.blocks * FlatMTree<DT>::KEYS * sizeof(DT);
+}
+
+// Numeric keys are stored level by level in one arena, with no per-node vectors or child pointers. Level 0 holds every
+// key in order, FANOUT keys per node; each level above holds the first key of every node of the level below, so node k's
+// children are nodes k * FANOUT ... of the next level down and are found by arithmetic. Every node starts with a
+// least-squares line from key to position and the largest error of that line over the node's keys. A lookup evaluates
+// the line and then only compares the few keys the error allows, instead of binary searching all FANOUT of them. The
+// line sits in front of the keys, so on smooth key sets (error 0 or 1) a level costs one multiply and a cache line or two.
+template <class DT>
+class FrozenMTree<DT, true> {
+    public:
+        static const int FANOUT = 1024; // Keys per node
+        class Model { // Line predicting a key's position within its node
+            public:
+                float slope; // Positions per unit of key
+                float intercept; // Predicted position of the node's first key
+                int error; // Largest distance between a predicted and a true position (plus one for rounding)
+                int count; // Keys in the node
+        };
+        static const int HEADER = sizeof(Model) > 16 ? sizeof(Model) : 16; // Bytes before a node's keys (keeps them aligned)
+        static const int STRIDE = (HEADER + FANOUT * sizeof(DT) + 63) / 64 * 64; // Bytes per node, whole cache lines
+        int n; // Number of keys
+        int levels; // Number of levels, level levels - 1 is a single node
+        long long levelStart[32]; // Byte offset of each level's first node in the arena
+        char* arena; // Every node of every level
+        FrozenMTree(const vector<DT>& sorted); // Packs sorted, distinct values
+        ~FrozenMTree(); // Destructor
+        Model& model(int level, int node) const; // Line of a node
+        DT* keys(int level, int node) const; // Keys of a node
+        static double predict(const Model& model, const DT& first, const DT& value); // Position the model gives value
+        static void fit(Model& model, const DT* keys, int count); // Fits the line and its error to one node
+        int rank_in(int level, int node, const DT& value) const; // Number of the node's keys <= value
+        bool contains(const DT& value) const; // Determine if a value is within the copy
+        size_t memory_usage() const; // Heap bytes held by the copy
+};
+template <class DT>
+const int FrozenMTree<DT, true>::FANOUT;
+template <class DT>
+FrozenMTree<DT, true>::FrozenMTree(const vector<DT>& sorted) { // Packs sorted, distinct values
+    n = sorted.size();
+    levels = 0;
+    int counts[32]; // Keys in each level
+    long long bytes = 0;
+    for (int count = n; count > 0;) { // Sizes of the levels, from the keys up to a single node
+        int nodes = (count + FANOUT - 1) / FANOUT;
+        counts[levels] = count;
+        levelStart[levels] = bytes;
+        bytes += (long long)nodes * STRIDE;
+        levels++;
+        count = nodes > 1 ? nodes : 0;
+    }
+    void* memory = nullptr;
+    if (bytes > 0 && posix_memalign(&memory, 64, bytes) != 0) {
+        throw bad_alloc();
+    }
+    arena = (char*)memory;
+
+    for (int level = 0; level < levels; level++) {
+        int nodes = (counts[level] + FANOUT - 1) / FANOUT;
+        for (int k = 0; k < nodes; k++) {
+            int count = min(FANOUT, counts[level] - k * FANOUT);
+            DT* row = keys(level, k);
+            for (int i = 0; i < count; i++) { // Level 0 copies the keys, every level above takes the first key of each node below
+                row[i] = level == 0 ? sorted[k * FANOUT + i] : keys(level - 1, k * FANOUT + i)[0];
+            }
+            fit(model(level, k), row, count);
+        }
+    }
+}
+template <class DT>
+FrozenMTree<DT, true>::~FrozenMTree() { // Destructor
+    free(arena);
+}
+template <class DT>
+typename FrozenMTree<DT, true>::Model& FrozenMTree<DT, true>::model(int level, int node) const { // Line of a node
+    return *(Model*)(arena + levelStart[level] + (long long)node * STRIDE);
+}
+template <class DT>
+DT* FrozenMTree<DT, true>::keys(int level, int node) const { // Keys of a node
+    return (DT*)(arena + levelStart[level] + (long long)node * STRIDE + HEADER);
+}
+template <class DT>
+double FrozenMTree<DT, true>::predict(const Model& model, const DT& first, const DT& value) { // Position the model gives value
+    return model.intercept + model.slope * ((double)value - (double)first); // Non-decreasing in value, which the search relies on
+}
+template <class DT>
+void FrozenMTree<DT, true>::fit(Model& model, const DT* keys, int count) { // Fits the line and its error to one node
+    double meanX = 0, meanY = (count - 1) / 2.0;
+    for (int i = 0; i < count; i++) {
+        meanX += ((double)keys[i] - (double)keys[0]) / count;
+    }
+    double sxy = 0, sxx = 0;
+    for (int i = 0; i < count; i++) {
+        double dx = (double)keys[i] - (double)keys[0] - meanX;
+        sxy += dx * (i - meanY);
+        sxx += dx * dx;
+    }
+    double slope = sxx > 0 ? sxy / sxx : 0.0;
+    model.count = count;
+    model.error = 0;
+    if (fabs(slope) <= FLT_MAX) { // Fails for inf and NaN, which wide-range floating point keys overflow to
+        model.slope = (float)slope;
+        model.intercept = (float)(meanY - model.slope * meanX);
+        for (int i = 0; i < count; i++) { // Measured with the stored (float) line, so the bound holds for exactly what lookups compute
+            double miss = fabs(predict(model, keys[0], keys[i]) - i);
+            if (!(miss < count)) { // Overflowed, or no better than scanning the node
+                model.error = count + 1;
+                break;
+            }
+            model.error = max(model.error, (int)miss + 1);
+        }
+    }
+    if (!(fabs(slope) <= FLT_MAX) || model.error > count) { // Flat line at position 0 whose error covers the whole node
+        model.slope = 0.0f;
+        model.intercept = 0.0f;
+        model.error = count;
+    }
+}
+// If key i is the last key <= value, value lies between keys i and i + 1, so its prediction lies between theirs and is
+// within error of i or of i + 1. Only the keys in that window are compared: every key left of it is <= value and every
+// key right of it is > value.
+template <class DT>
+int FrozenMTree<DT, true>::rank_in(int level, int node, const DT& value) const { // Number of the node's keys <= value
+    const Model& line = model(level, node);
+    const DT* row = keys(level, node);
+    double guess = predict(line, row[0], value);
+    double lowest = guess - line.error, highest = guess + line.error + 1; // Clamped before converting, guess can be far outside the node
+    int low = lowest > 0 ? (lowest < line.count ? (int)lowest : line.count) : 0; // A NaN guess (inf * 0) scans the whole node
+    int high = highest < line.count ? (highest > 0 ? (int)highest : 0) : line.count;
+    int rank = low;
+    for (int i = low; i < high; i++) { // Branch-free count of the window's keys <= value
+        rank += !(value < row[i]);
+    }
+    return rank;
+}
+template <class DT>
+bool FrozenMTree<DT, true>::contains(const DT& value) const { // Determine if a value is within the copy
+    if (n == 0 || value < keys(0, 0)[0]) {
+        return false;
+    }
+    int node = 0;
+    for (int level = levels - 1; level > 0; level--) {
+        node = node * FANOUT + rank_in(level, node, value) - 1; // The last key <= value starts the child to descend into
+    }
+    int position = rank_in(0, node, value) - 1;
+    return !(keys(0, node)[position] < value);
+}
+template <class DT>
+size_t FrozenMTree<DT, true>::memory_usage() const { // Heap bytes held by the copy
+    if (n == 0) {
+        return 0;
+    }
+    return levelStart[levels - 1] + STRIDE;
+}
+
+// Payload type of an MTree used as a plain set of keys.
+class NoValue {
+};
+
+// Payloads stored next to the keys of a leaf, index for index. Leaves only ever move keys in a few ways (insert or
+// erase one, move a run to or from a sibling), and each of those has a counterpart here.
+template <class VT>
+class LeafPayloads {
+    public:
+        vector<VT> items; // items[i] belongs to the leaf's values[i]
+        VT& operator[](int i); // Payload of key i
+        void insert(int i, const VT& payload); // Adds a payload for a key inserted at i
+        void erase(int i); // Drops the payload of key i
+        void push_back(const VT& payload); // Adds a payload for a key appended at the end
+        void pop_back(); // Drops the payload of the last key
+        void resize(int n); // Keeps the first n payloads
+        void append(const LeafPayloads& from, int begin, int end); // Appends from's payloads [begin, end)
+        void swap(LeafPayloads& other); // Exchanges contents
+        void clear(); // Drops every payload
+        size_t memory_usage() const; // Heap bytes held for the payloads
+};
+template <class VT>
+VT& LeafPayloads<VT>::operator[](int i) { // Payload of key i
+    return items[i];
+}
+template <class VT>
+void LeafPayloads<VT>::insert(int i, const VT& payload) { // Adds a payload for a key inserted at i
+    items.insert(items.begin() + i, payload);
+}
+template <class VT>
+void LeafPayloads<VT>::erase(int i) { // Drops the payload of key i
+    items.erase(items.begin() + i);
+}
+template <class VT>
+void LeafPayloads<VT>::push_back(const VT& payload) { // Adds a payload for a key appended at the end
+    items.push_back(payload);
+}
+template <class VT>
+void LeafPayloads<VT>::pop_back() { // Drops the payload of the last key
+    items.pop_back();
+}
+template <class VT>
+void LeafPayloads<VT>::resize(int n) { // Keeps the first n payloads
+    items.resize(n);
+}
+template <class VT>
+void LeafPayloads<VT>::append(const LeafPayloads<VT>& from, int begin, int end) { // Appends from's payloads [begin, end)
+    items.insert(items.end(), from.items.begin() + begin, from.items.begin() + end);
+}
+template <class VT>
+void LeafPayloads<VT>::swap(LeafPayloads<VT>& other) { // Exchanges contents
+    items.swap(other.items);
+}
+template <class VT>
+void LeafPayloads<VT>::clear() { // Drops every payload
+    items.clear();
+}
+template <class VT>
+size_t LeafPayloads<VT>::memory_usage() const { // Heap bytes held for the payloads
+    return items.capacity() * sizeof(VT);
+}
+// A set of keys has nothing to store, so every operation compiles away and the leaves stay as small as before.
+template <>
+class LeafPayloads<NoValue> {
+    public:
+        NoValue& operator[](int) {
+            static NoValue none;
+            return none;
+        }
+        void insert(int, const NoValue&) {
+        }
+        void erase(int) {
+        }
+        void push_back(const NoValue&) {
+        }
+        void pop_back() {
+        }
+        void resize(int) {
+        }
+        void append(const LeafPayloads&, int, int) {
+        }
+        void swap(LeafPayloads&) {
+        }
+        void clear() {
+        }
+        size_t memory_usage() const {
+            return 0;
+        }
+};
+
+// Multiway search tree of keys of type DT. With a payload type VT it is an ordered map: every key in a leaf has a payload
+// stored beside it, which moves with the key through splits, borrows and merges.
+template <class DT, class VT = NoValue>
 class MTree {
     protected:
         int M; // Maximum number of children per node
         vector<DT> values; // Values stored in the node
         vector<MTree*> children; // Pointers to child MTrees
+        LeafPayloads<VT> payloads; // Payload of each value (leaves only)
+        MTree* prev; // Previous leaf in value order (leaves only, nullptr for the first leaf)
+        MTree* next; // Next leaf in value order (leaves only, nullptr for the last leaf)
+        FlatMTree<DT>* flat; // Packed copy answering find while the tree is not being changed (root only, nullptr otherwise)
+        CompressedKeys<DT>* packed; // Compressed packed copy, used instead of flat in compressed mode (root only)
+        bool compressed; // Whether find packs the values compressed (root only)
+        FrozenMTree<DT>* snapshot; // Frozen snapshot, used instead of flat in frozen mode (root only)
+        bool frozen; // Whether find packs the values into a frozen snapshot (root only)
+        int size; // Number of values in the tree (kept by the root)
+        int readsSinceUpdate; // finds since the last insert, remove or rebuild (kept by the root)
     public:
+        // Forward iterator over the values in order. It walks a leaf and then follows the next link, so moving on is O(1).
+        class iterator {
+            public:
+                typedef forward_iterator_tag iterator_category;
+                typedef DT value_type;
+                typedef ptrdiff_t difference_type;
+                typedef const DT* pointer;
+                typedef const DT& reference;
+                MTree* leaf; // Leaf holding the current value (nullptr at the end)
+                int pos; // Index of the current value in leaf
+                iterator(MTree* leaf, int pos); // Positions on leaf->values[pos], moving on to the next leaf if pos is past its end
+                const DT& operator*() const; // Current value
+                const DT* operator->() const;
+                VT& payload() const; // Payload of the current value
+                iterator& operator++(); // Advance to the next value
+                iterator operator++(int);
+                bool operator==(const iterator& other) const;
+                bool operator!=(const iterator& other) const;
+        };
         MTree(int M); // MTree constructor given M value
         ~MTree(); // MTree destructor
         bool isLeaf() const; // Check if the current node is a leaf
         bool insert(DT& value); // Insert a value into the MTree
-        void split_node(); // Split the node if it exceeds capacity
+        bool insert(const DT& value, const VT& payload); // Insert a value with its payload, returns false if the value is already there
+        bool insert_into(const DT& value, const VT& payload, MTree*& sibling, DT& separator); // Insert below this node, reporting a split to the caller
+        VT* lookup(const DT& value); // Payload stored with value (nullptr if the value is not in the tree)
+        MTree* split_node(DT& separator); // Split the node if it exceeds capacity, returning the new right half
+        static int count_not_greater(const vector<DT>& keys, const DT& value); // Number of sorted keys <= value
+        int child_index(const DT& value) const; // Index of the child whose range holds value
         MTree* find_child(const DT& value); // Find child
         bool search(const DT& value); // Search for a value in the MTree
         void remove(const DT& value); // Delete a value from the MTree
+        bool remove_from(const DT& value); // Delete below this node, returns false if the value is not there
+        int fill() const; // Number of values in a leaf, or of children in an internal node
+        void rebalance_child(int i); // Borrow or merge so child i is no longer under-full
+        void merge_children(int i); // Merge child i + 1 into child i
         void buildTree(vector<DT>& input_values); // Build the tree
+        static const DT& key_of(const DT& value); // Key of an element of a bulk range (a bare key)
+        static const DT& key_of(const pair<DT, VT>& entry); // Key of an element of a bulk range (a key with its payload)
+        static VT payload_of(const DT& value); // Payload of a bare key (default constructed)
+        static const VT& payload_of(const pair<DT, VT>& entry); // Payload of a key with its payload
+        template <class Iter>
+        void bulk_load(Iter first, Iter last); // Build the tree bottom-up from a sorted range of distinct values (or (value, payload) pairs)
+        template <class Iter>
+        int bulk_merge(Iter first, Iter last); // Insert a sorted range in one pass, returns how many values were new
+        template <class Iter>
+        int merge_into(Iter& first, Iter last, const DT* upper, vector<MTree*>& siblings, vector<DT>& separators); // Merge the values below upper into this subtree
+        void split_many(vector<MTree*>& siblings, vector<DT>& separators); // Split an overfull node into as many even parts as needed
+        void clear(); // Remove every value and child
         vector<DT> collect_values(); // Collect values from all leaf nodes
+        void collect_into(vector<DT>& result); // Append the values of all leaves below this node to result
+        size_t memory_usage() const; // Heap bytes held by this node and its subtree (packed copies not included)
         bool find(DT& value); // Determine if a value is within the tree
+        void discard_flat(); // Drops the packed copy after a change
+        void set_compressed(bool compressed); // Chooses between the plain and the compressed packed copy
+        void set_frozen(bool frozen); // Chooses between the plain packed copy and the frozen snapshot
+        void link_after(MTree* leaf); // Puts leaf into the leaf list right after this leaf
+        void unlink(); // Takes this leaf out of the leaf list
+        void take_links(MTree* from); // Takes over from's place in the leaf list (for contents moved between nodes)
+        MTree* leaf_for(const DT& value); // The leaf whose range holds value
+        iterator begin(); // Iterator at the smallest value
+        iterator end(); // Iterator past the largest value
+        iterator lower_bound(const DT& value); // Iterator at the first value >= value, O(log n)
+        iterator upper_bound(const DT& value); // Iterator at the first value > value, O(log n)
 };
-template <class DT>
-MTree<DT>::MTree(int M) { // MTree constructor given M value
+template <class DT, class VT>
+MTree<DT, VT>::MTree(int M) { // MTree constructor given M value
     (*this).M = M;
+    (*this).prev = nullptr;
+    (*this).next = nullptr;
+    (*this).flat = nullptr;
+    (*this).packed = nullptr;
+    (*this).compressed = false;
+    (*this).snapshot = nullptr;
+    (*this).frozen = false;
+    (*this).size = 0;
+    (*this).readsSinceUpdate = 0;
+}
+template <class DT, class VT>
+MTree<DT, VT>::~MTree() { // MTree destructor
+    for (int i = 0; i < (int)children.size(); i++) { // Deletes all children's children recursively
+        delete children[i];
+    }
+
+    children.clear();
+    delete flat;
+    delete packed;
+    delete snapshot;
+}
+template <class DT, class VT>
+bool MTree<DT, VT>::isLeaf() const { // Check if the current node is a leaf
+    if (children.size() < 1) { // Uses the size of the nodes children vector
+        return true; // If node has less than 1 children (mostly equivalent to 0) return true
+    }
+    return false; // If node has greater than or equal to 1 children then it is not a leaf node
+}
+// Leaves hold at most M - 1 values and internal nodes at most M children. An internal node keeps one separator between
+// each pair of children: separator i is the smallest value of child i + 1, so a value equal to it belongs to the right.
+template <class DT, class VT>
+bool MTree<DT, VT>::insert(DT& value) { // Insert a value into the MTree
+    return insert(value, VT());
+}
+template <class DT, class VT>
+bool MTree<DT, VT>::insert(const DT& value, const VT& payload) { // Insert a value with its payload
+    MTree<DT, VT>* sibling;
+    DT separator;
+    if (!insert_into(value, payload, sibling, separator)) { // Determines if value is already within MTree
+        return false; // Returns false to verify the value was not inserted
+    }
+    discard_flat();
+    size++;
+    if (sibling) { // The root split, so its old contents move to a new left child (the root stays this object)
+        MTree<DT, VT>* left = new MTree<DT, VT>(M);
+        left->values.swap(values);
+        left->payloads.swap(payloads);
+        left->children.swap(children);
+        left->take_links(this);
+        values.push_back(separator);
+        children.push_back(left);
+        children.push_back(sibling);
+    }
+    return true; // Returns true to verify that the value was inserted
+}
+template <class DT, class VT>
+bool MTree<DT, VT>::insert_into(const DT& value, const VT& payload, MTree<DT, VT>*& sibling, DT& separator) { // Insert below this node
+    sibling = nullptr;
+    if (isLeaf()) {
+        typename vector<DT>::iterator pos = std::lower_bound(values.begin(), values.end(), value); // Keep the leaf sorted
+        if (pos != values.end() && *pos == value) { // Already in the tree
+            return false;
+        }
+        payloads.insert(pos - values.begin(), payload);
+        values.insert(pos, value);
+        if ((int)values.size() > M - 1) { // Too many values for one leaf
+            sibling = split_node(separator);
+        }
+        return true;
+    }
+
+    int i = child_index(value);
+    MTree<DT, VT>* childSibling;
+    DT childSeparator;
+    if (!children[i]->insert_into(value, payload, childSibling, childSeparator)) {
+        return false;
+    }
+    if (childSibling) { // The child split, so its new right half goes in right after it
+        values.insert(values.begin() + i, childSeparator);
+        children.insert(children.begin() + i + 1, childSibling);
+        if ((int)children.size() > M) { // Too many children, split this node as well
+            sibling = split_node(separator);
+        }
+    }
+    return true;
+}
+template <class DT, class VT>
+MTree<DT, VT>* MTree<DT, VT>::split_node(DT& separator) { // Split the node in half, returning the right half and the separator for the parent
+    MTree<DT, VT>* right = new MTree<DT, VT>(M);
+    if (isLeaf()) {
+        int half = values.size() / 2; // Values kept on the left
+        right->values.assign(values.begin() + half, values.end());
+        right->payloads.append(payloads, half, values.size());
+        values.resize(half);
+        payloads.resize(half);
+        link_after(right);
+        separator = right->values[0]; // Leaves keep every value, the parent gets a copy
+    }
+    else {
+        int half = (children.size() + 1) / 2; // Children kept on the left
+        separator = values[half - 1]; // The middle separator moves up to the parent
+        right->values.assign(values.begin() + half, values.end());
+        right->children.assign(children.begin() + half, children.end());
+        values.resize(half - 1);
+        children.resize(half);
+    }
+    return right;
+}
+// Binary search without data-dependent branches: each step halves the range and the compare only picks which half
+// to keep (a conditional move), so wide nodes do not pay for a mispredicted branch at every level of the search.
+template <class DT, class VT>
+int MTree<DT, VT>::count_not_greater(const vector<DT>& keys, const DT& value) { // Number of sorted keys <= value
+    int n = keys.size();
+    if (n == 0) {
+        return 0;
+    }
+    const DT* base = keys.data(); // keys[base..base + n) still holds the last key <= value, if there is one
+    while (n > 1) {
+        int half = n / 2;
+        base = (value < base[half]) ? base : base + half;
+        n -= half;
+    }
+    return (base - keys.data()) + !(value < *base);
+}
+template <class DT, class VT>
+int MTree<DT, VT>::child_index(const DT& value) const { // Index of the child whose range holds value
+    return count_not_greater(values, value); // Number of separators <= value
+}
+template <class DT, class VT>
+MTree<DT, VT>* MTree<DT, VT>::find_child(const DT& value) { // Find child
+    return children[child_index(value)];
+}
+template <class DT, class VT>
+bool MTree<DT, VT>::search(const DT& value) { // Search for a value in the MTree
+    MTree<DT, VT>* node = this;
+    while (!node->isLeaf()) { // Follow the separators down to the only leaf that can hold the value
+        node = node->find_child(value);
+    }
+
+    // Only leaves hold values (separators may be copies of values that were removed since)
+    int i = count_not_greater(node->values, value);
+    return i > 0 && !(node->values[i - 1] < value);
+}
+template <class DT, class VT>
+VT* MTree<DT, VT>::lookup(const DT& value) { // Payload stored with value
+    MTree<DT, VT>* node = leaf_for(value);
+    int i = count_not_greater(node->values, value);
+    if (i > 0 && !(node->values[i - 1] < value)) {
+        return &node->payloads[i - 1];
+    }
+    return nullptr;
+}
+template <class DT, class VT>
+void MTree<DT, VT>::remove(const DT& value) { // Delete a value from the MTree
+    if (!remove_from(value)) { // If the value was not found in the tree
+        throw NotFoundException(); // Throw a NotFoundException to indicate an error
+    }
+    discard_flat();
+    size--;
+    while (!isLeaf() && children.size() == 1) { // A root with a single child is replaced by that child
+        MTree<DT, VT>* only = children[0];
+        values.swap(only->values);
+        payloads.swap(only->payloads);
+        children.swap(only->children);
+        only->children.clear(); // It was handed our old list, which still points back at it
+        take_links(only);
+        delete only;
+    }
+}
+template <class DT, class VT>
+bool MTree<DT, VT>::remove_from(const DT& value) { // Delete below this node
+    if (isLeaf()) {
+        typename vector<DT>::iterator pos = std::lower_bound(values.begin(), values.end(), value);
+        if (pos == values.end() || !(*pos == value)) {
+            return false;
+        }
+        payloads.erase(pos - values.begin());
+        values.erase(pos); // Separators above may still hold a copy, which is fine for routing
+        return true;
+    }
+
+    int i = child_index(value);
+    if (!children[i]->remove_from(value)) {
+        return false;
+    }
+    rebalance_child(i);
+    return true;
+}
+template <class DT, class VT>
+int MTree<DT, VT>::fill() const { // Number of values in a leaf, or of children in an internal node
+    return isLeaf() ? values.size() : children.size();
+}
+// A leaf needs at least M / 2 values and an internal node (M + 1) / 2 children; two siblings that cannot lend always fit
+// in one node. Only siblings of the same kind (both leaves or both internal) are combined, and a child with no such
+// sibling is left as is unless it is empty or has a single child.
+template <class DT, class VT>
+void MTree<DT, VT>::rebalance_child(int i) { // Borrow or merge so child i is no longer under-full
+    MTree<DT, VT>* child = children[i];
+    bool leaf = child->isLeaf();
+    int minimum = leaf ? M / 2 : (M + 1) / 2;
+    if (child->fill() >= minimum) {
+        return;
+    }
+
+    MTree<DT, VT>* left = (i > 0 && children[i - 1]->isLeaf() == leaf) ? children[i - 1] : nullptr;
+    MTree<DT, VT>* right = (i + 1 < (int)children.size() && children[i + 1]->isLeaf() == leaf) ? children[i + 1] : nullptr;
+    if (left && left->fill() > minimum) { // Borrow the last entry of the left sibling
+        if (leaf) {
+            child->values.insert(child->values.begin(), left->values.back());
+            child->payloads.insert(0, left->payloads[left->values.size() - 1]);
+            left->values.pop_back();
+            left->payloads.pop_back();
+            values[i - 1] = child->values[0];
+        }
+        else { // Rotate through the separator
+            child->children.insert(child->children.begin(), left->children.back());
+            child->values.insert(child->values.begin(), values[i - 1]);
+            values[i - 1] = left->values.back();
+            left->children.pop_back();
+            left->values.pop_back();
+        }
+    }
+    else if (right && right->fill() > minimum) { // Borrow the first entry of the right sibling
+        if (leaf) {
+            child->values.push_back(right->values.front());
+            child->payloads.push_back(right->payloads[0]);
+            right->values.erase(right->values.begin());
+            right->payloads.erase(0);
+            values[i] = right->values[0];
+        }
+        else {
+            child->children.push_back(right->children.front());
+            child->values.push_back(values[i]);
+            values[i] = right->values.front();
+            right->children.erase(right->children.begin());
+            right->values.erase(right->values.begin());
+        }
+    }
+    else if (left) {
+        merge_children(i - 1);
+    }
+    else if (right) {
+        merge_children(i);
+    }
+    else if (leaf && child->values.empty()) { // No sibling to merge with, drop the empty leaf and one separator next to it
+        if (!values.empty()) {
+            values.erase(values.begin() + (i > 0 ? i - 1 : 0));
+        }
+        children.erase(children.begin() + i);
+        child->unlink();
+        delete child;
+    }
+    else if (!leaf && child->children.size() == 1) { // Replace a node that only routes to one child by that child
+        children[i] = child->children[0];
+        child->children.clear();
+        delete child;
+    }
+}
+template <class DT, class VT>
+void MTree<DT, VT>::merge_children(int i) { // Merge child i + 1 into child i
+    MTree<DT, VT>* left = children[i];
+    MTree<DT, VT>* right = children[i + 1];
+    if (!left->isLeaf()) { // The separator comes down between the two sets of children
+        left->values.push_back(values[i]);
+    }
+    else {
+        left->payloads.append(right->payloads, 0, right->values.size());
+    }
+    left->values.insert(left->values.end(), right->values.begin(), right->values.end());
+    left->children.insert(left->children.end(), right->children.begin(), right->children.end());
+    right->children.clear(); // Its children now belong to left
+    right->unlink(); // For leaves, left now holds right's values
+    delete right;
+    values.erase(values.begin() + i);
+    children.erase(children.begin() + i + 1);
+}
+template <class DT, class VT>
+void MTree<DT, VT>::buildTree(vector<DT>& input_values) { // Build the tree given a vector of values
+    bulk_load(input_values.begin(), input_values.end());
+}
+template <class DT, class VT>
+void MTree<DT, VT>::clear() { // Remove every value and child
+    discard_flat();
+    size = 0;
+    values.clear(); // Clear the current node's values
+    payloads.clear();
+    for (int i = 0; i < (int)children.size(); i++) { // Delete all child nodes
+        delete children[i];
+    }
+    children.clear(); // Clear the children vector
+}
+template <class DT, class VT>
+const DT& MTree<DT, VT>::key_of(const DT& value) { // Key of a bare key
+    return value;
+}
+template <class DT, class VT>
+const DT& MTree<DT, VT>::key_of(const pair<DT, VT>& entry) { // Key of a key with its payload
+    return entry.first;
+}
+template <class DT, class VT>
+VT MTree<DT, VT>::payload_of(const DT&) { // Payload of a bare key
+    return VT();
+}
+template <class DT, class VT>
+const VT& MTree<DT, VT>::payload_of(const pair<DT, VT>& entry) { // Payload of a key with its payload
+    return entry.second;
+}
+// The loader makes one pass over the input: values go straight into full leaves (M - 1 values each) as they arrive, and
+// each level above is built from the one below, M children per node. Only the level being built is held in a list, so
+// nothing is copied apart from each value into its leaf, and every leaf ends up at the same depth.
+template <class DT, class VT>
+template <class Iter>
+void MTree<DT, VT>::bulk_load(Iter first, Iter last) { // Build the tree bottom-up from a sorted range of distinct values
+    clear();
+    vector<MTree<DT, VT>*> level; // Nodes of the level being built, in order
+    vector<DT> minimums; // Smallest value below each node in level
+    MTree<DT, VT>* leaf = nullptr;
+    for (; first != last; ++first) {
+        if (!leaf || (int)leaf->values.size() == M - 1) { // Start a new leaf
+            MTree<DT, VT>* previous = leaf;
+            leaf = new MTree<DT, VT>(M);
+            if (previous) {
+                previous->link_after(leaf);
+            }
+            level.push_back(leaf);
+            minimums.push_back(key_of(*first));
+        }
+        leaf->values.push_back(key_of(*first));
+        leaf->payloads.push_back(payload_of(*first));
+        size++;
+    }
+    if (level.empty()) {
+        return;
+    }
+    if (level.size() > 1 && (int)leaf->values.size() < M / 2) { // Even out the last two leaves so the last one is not under-full
+        MTree<DT, VT>* previous = level[level.size() - 2];
+        int total = previous->values.size() + leaf->values.size();
+        int move = total / 2 - leaf->values.size();
+        int keep = previous->values.size() - move;
+        LeafPayloads<VT> moved;
+        moved.append(previous->payloads, keep, previous->values.size());
+        moved.append(leaf->payloads, 0, leaf->values.size());
+        leaf->payloads.swap(moved);
+        leaf->values.insert(leaf->values.begin(), previous->values.begin() + keep, previous->values.end());
+        previous->values.resize(keep);
+        previous->payloads.resize(keep);
+        minimums.back() = leaf->values[0];
+    }
+
+    while (level.size() > 1) { // Group each level into parents, spreading the children evenly over as few parents as possible
+        int count = level.size();
+        int groups = (count + M - 1) / M;
+        vector<MTree<DT, VT>*> parents;
+        vector<DT> parentMinimums;
+        parents.reserve(groups);
+        parentMinimums.reserve(groups);
+        int start = 0;
+        for (int g = 0; g < groups; g++) {
+            int end = start + count / groups + (g < count % groups ? 1 : 0);
+            MTree<DT, VT>* parent = new MTree<DT, VT>(M);
+            parent->children.assign(level.begin() + start, level.begin() + end);
+            parent->values.assign(minimums.begin() + start + 1, minimums.begin() + end); // Separator i is the smallest value of child i + 1
+            parents.push_back(parent);
+            parentMinimums.push_back(minimums[start]);
+            start = end;
+        }
+        level.swap(parents);
+        minimums.swap(parentMinimums);
+    }
+
+    MTree<DT, VT>* top = level[0]; // The root stays this object, so take over the top node's contents
+    values.swap(top->values);
+    payloads.swap(top->payloads);
+    children.swap(top->children);
+    take_links(top);
+    delete top;
+}
+template <class DT, class VT>
+template <class Iter>
+int MTree<DT, VT>::bulk_merge(Iter first, Iter last) { // Insert a sorted range in one pass, returns how many values were new
+    vector<MTree<DT, VT>*> siblings;
+    vector<DT> separators;
+    int inserted = merge_into(first, last, nullptr, siblings, separators);
+    while (!siblings.empty()) { // The root split, so its parts go under a new root level (the root stays this object)
+        MTree<DT, VT>* left = new MTree<DT, VT>(M);
+        left->values.swap(values);
+        left->payloads.swap(payloads);
+        left->children.swap(children);
+        left->take_links(this);
+        values.swap(separators);
+        children.push_back(left);
+        children.insert(children.end(), siblings.begin(), siblings.end());
+        siblings.clear();
+        separators.clear();
+        if ((int)children.size() > M) { // More parts than one node can hold
+            split_many(siblings, separators);
+        }
+    }
+    if (inserted > 0) {
+        discard_flat();
+        size += inserted;
+    }
+    return inserted;
+}
+// Each node hands every child only the values that fall in that child's range, so a leaf is visited once no matter how
+// many values land in it, and leaves the batch does not touch are never visited. Nodes that overflow are split into as
+// many parts as needed, and the parts are handed back to the parent in one go.
+template <class DT, class VT>
+template <class Iter>
+int MTree<DT, VT>::merge_into(Iter& first, Iter last, const DT* upper, vector<MTree<DT, VT>*>& siblings, vector<DT>& separators) { // Merge the values below upper into this subtree
+    int inserted = 0;
+    if (isLeaf()) {
+        vector<DT> merged;
+        LeafPayloads<VT> mergedPayloads;
+        merged.reserve(values.size() + 1);
+        int i = 0;
+        while (first != last && (!upper || key_of(*first) < *upper)) { // Standard merge of two sorted runs, dropping duplicates
+            const DT& key = key_of(*first);
+            int run = i;
+            while (i < (int)values.size() && values[i] < key) {
+                merged.push_back(values[i++]);
+            }
+            mergedPayloads.append(payloads, run, i);
+            if ((i == (int)values.size() || key < values[i]) && (merged.empty() || merged.back() < key)) { // New, and not repeated in the batch (existing payloads are kept)
+                merged.push_back(key);
+                mergedPayloads.push_back(payload_of(*first));
+                inserted++;
+            }
+            ++first;
+        }
+        mergedPayloads.append(payloads, i, values.size());
+        merged.insert(merged.end(), values.begin() + i, values.end());
+        values.swap(merged);
+        payloads.swap(mergedPayloads);
+        if ((int)values.size() > M - 1) {
+            split_many(siblings, separators);
+        }
+        return inserted;
+    }
+
+    vector<MTree<DT, VT>*> newChildren; // Children (with any new parts) and separators after the merge
+    vector<DT> newValues;
+    newChildren.reserve(children.size());
+    newValues.reserve(values.size());
+    for (int i = 0; i < (int)children.size(); i++) {
+        const DT* bound = i < (int)values.size() ? &values[i] : upper; // Values below bound belong to child i
+        if (i > 0) {
+            newValues.push_back(values[i - 1]);
+        }
+        newChildren.push_back(children[i]);
+        if (first != last && (!bound || key_of(*first) < *bound)) {
+            vector<MTree<DT, VT>*> childSiblings;
+            vector<DT> childSeparators;
+            inserted += children[i]->merge_into(first, last, bound, childSiblings, childSeparators);
+            for (int j = 0; j < (int)childSiblings.size(); j++) {
+                newValues.push_back(childSeparators[j]);
+                newChildren.push_back(childSiblings[j]);
+            }
+        }
+    }
+    values.swap(newValues);
+    children.swap(newChildren);
+    if ((int)children.size() > M) {
+        split_many(siblings, separators);
+    }
+    return inserted;
+}
+template <class DT, class VT>
+void MTree<DT, VT>::split_many(vector<MTree<DT, VT>*>& siblings, vector<DT>& separators) { // Split an overfull node into as many even parts as needed
+    bool leaf = isLeaf();
+    int count = leaf ? values.size() : children.size();
+    int capacity = leaf ? M - 1 : M;
+    int parts = (count + capacity - 1) / capacity;
+    int keep = count / parts + (count % parts > 0 ? 1 : 0); // Entries this node keeps
+    int start = keep;
+    MTree<DT, VT>* tail = this; // Last leaf part so far, for the leaf list
+    for (int p = 1; p < parts; p++) {
+        int end = start + count / parts + (p < count % parts ? 1 : 0);
+        MTree<DT, VT>* part = new MTree<DT, VT>(M);
+        if (leaf) {
+            part->values.assign(values.begin() + start, values.begin() + end);
+            part->payloads.append(payloads, start, end);
+            tail->link_after(part);
+            tail = part;
+            separators.push_back(values[start]);
+        }
+        else { // Separator start - 1 moves up to the parent, the ones inside the part stay with it
+            part->children.assign(children.begin() + start, children.begin() + end);
+            part->values.assign(values.begin() + start, values.begin() + end - 1);
+            separators.push_back(values[start - 1]);
+        }
+        siblings.push_back(part);
+        start = end;
+    }
+    if (leaf) {
+        values.resize(keep);
+        payloads.resize(keep);
+    }
+    else {
+        children.resize(keep);
+        values.resize(keep - 1);
+    }
+}
+template <class DT, class VT>
+vector<DT> MTree<DT, VT>::collect_values() { // Collect values from all leaf nodes
+    vector<DT> result; // Stores the collected values
+    collect_into(result);
+    return result; // Return all collected values
+}
+template <class DT, class VT>
+void MTree<DT, VT>::collect_into(vector<DT>& result) { // Append the values of all leaves below this node to result
+    if (isLeaf()) { // If the node is a leaf
+        result.insert(result.end(), values.begin(), values.end()); // Add each value to the result
+        return;
+    }
+    for (int i = 0; i < (int)children.size(); i++) { // Iterates through all children
+        children[i]->collect_into(result); // Recursively collect values from the children
+    }
+}
+template <class DT, class VT>
+size_t MTree<DT, VT>::memory_usage() const { // Heap bytes held by this node and its subtree
+    size_t bytes = sizeof(MTree) + values.capacity() * sizeof(DT) + children.capacity() * sizeof(MTree*) + payloads.memory_usage();
+    for (int i = 0; i < (int)children.size(); i++) {
+        bytes += children[i]->memory_usage();
+    }
+    return bytes;
+}
+template <class DT, class VT>
+bool MTree<DT, VT>::find(DT& value) { // Determine if a value is within the tree
+    if (flat) {
+        return flat->contains(value);
+    }
+    if (packed) {
+        return packed->contains(value);
+    }
+    if (snapshot) {
+        return snapshot->contains(value);
+    }
+    // Once enough lookups have gone by without a change to pay for packing the values (O(n)), answer from a packed copy
+    if (++readsSinceUpdate > size / 16 + 32) {
+        if (compressed) {
+            packed = new CompressedKeys<DT>(collect_values());
+            return packed->contains(value);
+        }
+        if (frozen) {
+            snapshot = new FrozenMTree<DT>(collect_values());
+            return snapshot->contains(value);
+        }
+        flat = new FlatMTree<DT>(collect_values());
+        return flat->contains(value);
+    }
+    return search(value); // One root-to-leaf path, O(log n)
+}
+template <class DT, class VT>
+void MTree<DT, VT>::discard_flat() { // Drops the packed copy after a change
+    delete flat;
+    flat = nullptr;
+    delete packed;
+    packed = nullptr;
+    delete snapshot;
+    snapshot = nullptr;
+    readsSinceUpdate = 0;
+}
+template <class DT, class VT>
+void MTree<DT, VT>::set_compressed(bool compressed) { // Chooses between the plain and the compressed packed copy
+    discard_flat();
+    (*this).compressed = compressed;
+}
+template <class DT, class VT>
+void MTree<DT, VT>::set_frozen(bool frozen) { // Chooses between the plain packed copy and the frozen snapshot
+    discard_flat();
+    (*this).frozen = frozen;
+}
+template <class DT, class VT>
+void MTree<DT, VT>::link_after(MTree<DT, VT>* leaf) { // Puts leaf into the leaf list right after this leaf
+    leaf->prev = this;
+    leaf->next = next;
+    if (next) {
+        next->prev = leaf;
+    }
+    next = leaf;
+}
+template <class DT, class VT>
+void MTree<DT, VT>::unlink() { // Takes this leaf out of the leaf list
+    if (prev) {
+        prev->next = next;
+    }
+    if (next) {
+        next->prev = prev;
+    }
+    prev = nullptr;
+    next = nullptr;
+}
+template <class DT, class VT>
+void MTree<DT, VT>::take_links(MTree<DT, VT>* from) { // Takes over from's place in the leaf list
+    prev = from->prev;
+    next = from->next;
+    if (prev) {
+        prev->next = this;
+    }
+    if (next) {
+        next->prev = this;
+    }
+    from->prev = nullptr;
+    from->next = nullptr;
+}
+template <class DT, class VT>
+MTree<DT, VT>* MTree<DT, VT>::leaf_for(const DT& value) { // The leaf whose range holds value
+    MTree<DT, VT>* node = this;
+    while (!node->isLeaf()) {
+        node = node->find_child(value);
+    }
+    return node;
+}
+template <class DT, class VT>
+typename MTree<DT, VT>::iterator MTree<DT, VT>::begin() { // Iterator at the smallest value
+    MTree<DT, VT>* node = this;
+    while (!node->isLeaf()) {
+        node = node->children[0];
+    }
+    return iterator(node, 0);
+}
+template <class DT, class VT>
+typename MTree<DT, VT>::iterator MTree<DT, VT>::end() { // Iterator past the largest value
+    return iterator(nullptr, 0);
+}
+template <class DT, class VT>
+typename MTree<DT, VT>::iterator MTree<DT, VT>::lower_bound(const DT& value) { // Iterator at the first value >= value
+    MTree<DT, VT>* leaf = leaf_for(value); // Later leaves only hold larger values, so the answer is here or at the start of the next one
+    int i = count_not_greater(leaf->values, value);
+    if (i > 0 && !(leaf->values[i - 1] < value)) { // value itself is in the tree
+        i--;
+    }
+    return iterator(leaf, i);
+}
+template <class DT, class VT>
+typename MTree<DT, VT>::iterator MTree<DT, VT>::upper_bound(const DT& value) { // Iterator at the first value > value
+    MTree<DT, VT>* leaf = leaf_for(value);
+    return iterator(leaf, count_not_greater(leaf->values, value));
+}
+template <class DT, class VT>
+MTree<DT, VT>::iterator::iterator(MTree<DT, VT>* leaf, int pos) { // Positions on leaf->values[pos], moving on past the end of a leaf
+    while (leaf && pos >= (int)leaf->values.size()) {
+        leaf = leaf->next;
+        pos = 0;
+    }
+    (*this).leaf = leaf;
+    (*this).pos = pos;
+}
+template <class DT, class VT>
+const DT& MTree<DT, VT>::iterator::operator*() const { // Current value
+    return leaf->values[pos];
+}
+template <class DT, class VT>
+const DT* MTree<DT, VT>::iterator::operator->() const {
+    return &leaf->values[pos];
+}
+template <class DT, class VT>
+VT& MTree<DT, VT>::iterator::payload() const { // Payload of the current value
+    return leaf->payloads[pos];
+}
+template <class DT, class VT>
+typename MTree<DT, VT>::iterator& MTree<DT, VT>::iterator::operator++() { // Advance to the next value
+    *this = iterator(leaf, pos + 1);
+    return *this;
+}
+template <class DT, class VT>
+typename MTree<DT, VT>::iterator MTree<DT, VT>::iterator::operator++(int) {
+    iterator before = *this;
+    ++*this;
+    return before;
+}
+template <class DT, class VT>
+bool MTree<DT, VT>::iterator::operator==(const iterator& other) const {
+    return leaf == other.leaf && pos == other.pos;
+}
+template <class DT, class VT>
+bool MTree<DT, VT>::iterator::operator!=(const iterator& other) const {
+    return !(*this == other);
+}
+
+// Version lock for optimistic lock coupling. The word counts modifications in steps of 2 and bit 1 is set while a writer
+// holds the lock. Readers take no lock at all: they note the version, read, and check that the version has not moved.
+class OptimisticLock {
+    public:
+        atomic<unsigned long long> word; // Version number (times 2) plus the locked bit
+        OptimisticLock(); // Constructor
+        unsigned long long read_lock(bool& restart); // Waits for writers to finish and returns the version to validate against
+        void check(unsigned long long version, bool& restart); // Sets restart if the node changed since version was read
+        void upgrade(unsigned long long& version, bool& restart); // Turns a read into the write lock, unless the node changed
+        void write_unlock(); // Releases the write lock and publishes a new version
+};
+OptimisticLock::OptimisticLock() : word(0) { // Constructor
+}
+unsigned long long OptimisticLock::read_lock(bool& restart) { // Waits for writers to finish and returns the version
+    unsigned long long version = word.load(memory_order_acquire);
+    while (version & 2) { // A writer holds the node
+        this_thread::yield();
+        version = word.load(memory_order_acquire);
+    }
+    restart = false;
+    return version;
+}
+void OptimisticLock::check(unsigned long long version, bool& restart) { // Sets restart if the node changed since version was read
+    atomic_thread_fence(memory_order_acquire);
+    if (word.load(memory_order_relaxed) != version) {
+        restart = true;
+    }
+}
+void OptimisticLock::upgrade(unsigned long long& version, bool& restart) { // Turns a read into the write lock
+    if (word.compare_exchange_strong(version, version + 2, memory_order_acquire)) {
+        version += 2;
+    }
+    else {
+        restart = true;
+    }
+}
+void OptimisticLock::write_unlock() { // Clears the locked bit and bumps the version in one step
+    word.fetch_add(2, memory_order_release);
+}
+
+// Node of a ConcurrentMTree. Keys and children live in arrays of fixed capacity that never move, so a reader racing with a
+// writer may see stale values but never freed memory; the version check then sends it back to the root. That only holds
+// for keys that are plain bytes: copying a key that owns memory (a string) could follow a pointer the writer just freed.
+template <class DT>
+class ConcurrentNode {
+    static_assert(is_trivially_copyable<DT>::value, "ConcurrentMTree readers copy keys while writers move them");
+    public:
+        OptimisticLock lock; // Version lock guarding every field below
+        bool leaf; // True for leaves
+        int count; // Number of keys
+        DT* keys; // Sorted keys (leaves) or separators (internal nodes), capacity M - 1
+        ConcurrentNode** children; // count + 1 children of an internal node, capacity M
+        ConcurrentNode(int M, bool leaf); // Constructor
+        ~ConcurrentNode(); // Destructor (frees the whole subtree)
+        int child_index(const DT& key) const; // Index of the child whose range holds key
+        int position(const DT& key) const; // Number of keys below key
+        ConcurrentNode* split(int M, DT& separator); // Moves the upper half into a new right sibling
+        void insert_child(const DT& separator, ConcurrentNode* right); // Adds a child after a split
+};
+template <class DT>
+ConcurrentNode<DT>::ConcurrentNode(int M, bool leaf) { // Constructor
+    (*this).leaf = leaf;
+    (*this).count = 0;
+    keys = new DT[M - 1];
+    children = leaf ? nullptr : new ConcurrentNode*[M](); // A reader that sees count before a new child sees nullptr, not garbage
+}
+template <class DT>
+ConcurrentNode<DT>::~ConcurrentNode() { // Destructor
+    if (!leaf) {
+        for (int i = 0; i <= count; i++) {
+            delete children[i];
+        }
+    }
+    delete[] keys;
+    delete[] children;
+}
+template <class DT>
+int ConcurrentNode<DT>::child_index(const DT& key) const { // Number of separators <= key
+    int i = 0;
+    while (i < count && !(key < keys[i])) {
+        i++;
+    }
+    return i;
+}
+template <class DT>
+int ConcurrentNode<DT>::position(const DT& key) const { // Number of keys below key
+    int i = 0;
+    while (i < count && keys[i] < key) {
+        i++;
+    }
+    return i;
+}
+template <class DT>
+ConcurrentNode<DT>* ConcurrentNode<DT>::split(int M, DT& separator) { // Moves the upper half into a new right sibling
+    ConcurrentNode<DT>* right = new ConcurrentNode<DT>(M, leaf);
+    int half = count / 2;
+    if (leaf) { // Leaves keep every key, the parent gets a copy of the first key on the right
+        right->count = count - half;
+        for (int i = 0; i < right->count; i++) {
+            right->keys[i] = keys[half + i];
+        }
+        separator = right->keys[0];
+    }
+    else { // The middle separator moves up
+        separator = keys[half];
+        right->count = count - half - 1;
+        for (int i = 0; i < right->count; i++) {
+            right->keys[i] = keys[half + 1 + i];
+        }
+        for (int i = 0; i <= right->count; i++) {
+            right->children[i] = children[half + 1 + i];
+        }
+    }
+    count = half;
+    return right;
+}
+template <class DT>
+void ConcurrentNode<DT>::insert_child(const DT& separator, ConcurrentNode<DT>* right) { // Adds a child after a split
+    int i = child_index(separator);
+    for (int j = count; j > i; j--) {
+        keys[j] = keys[j - 1];
+        children[j + 1] = children[j];
+    }
+    keys[i] = separator;
+    children[i + 1] = right;
+    count++;
+}
+
+// Multiway search tree for many reader threads and concurrent writers, using optimistic lock coupling. Readers never
+// write shared memory: they walk down checking each node's version after reading it and start over if a writer got in.
+// Writers descend the same way and lock only the leaf they change, plus its parent when a split is needed. Full nodes
+// are split on the way down, so a split never has to climb back up. Removal leaves under-full leaves in place (no merges),
+// which means a node is never freed while the tree is in use, and readers can always finish reading a node safely.
+template <class DT>
+class ConcurrentMTree {
+    public:
+        int M; // Maximum number of children per node (at least 3)
+        atomic<ConcurrentNode<DT>*> root; // Root node, replaced only by a thread holding the old root's lock
+        ConcurrentMTree(int M); // Constructor
+        ~ConcurrentMTree(); // Destructor
+        ConcurrentNode<DT>* find_leaf(const DT& value, unsigned long long& version); // Optimistic descent to the leaf for value (nullptr to restart)
+        bool find(const DT& value); // Determine if a value is within the tree
+        bool insert(const DT& value); // Insert a value, returns false if it was already there
+        bool remove(const DT& value); // Delete a value, returns false if it was not there
+        bool split_child(ConcurrentNode<DT>* parent, unsigned long long& parentVersion, ConcurrentNode<DT>* node, unsigned long long& version); // Splits a full node, false if it has to restart
+        void collect_into(ConcurrentNode<DT>* node, vector<DT>& result); // Append every value below node in order (no writers may run)
+};
+template <class DT>
+ConcurrentMTree<DT>::ConcurrentMTree(int M) { // Constructor
+    (*this).M = M < 3 ? 3 : M;
+    root.store(new ConcurrentNode<DT>((*this).M, true));
+}
+template <class DT>
+ConcurrentMTree<DT>::~ConcurrentMTree() { // Destructor
+    delete root.load();
+}
+// Lock coupling without locks: a child pointer is only used once the parent's version shows it was read from a stable
+// node, and the parent is checked again after the child's version is taken, so a split of the child in between is caught.
+template <class DT>
+ConcurrentNode<DT>* ConcurrentMTree<DT>::find_leaf(const DT& value, unsigned long long& version) { // Optimistic descent to the leaf for value
+    bool restart = false;
+    ConcurrentNode<DT>* node = root.load();
+    version = node->lock.read_lock(restart);
+    if (node != root.load()) { // The tree grew a level before the version was read
+        return nullptr;
+    }
+    while (!node->leaf) {
+        ConcurrentNode<DT>* child = node->children[node->child_index(value)];
+        node->lock.check(version, restart);
+        if (restart) {
+            return nullptr;
+        }
+        unsigned long long childVersion = child->lock.read_lock(restart);
+        node->lock.check(version, restart);
+        if (restart) {
+            return nullptr;
+        }
+        node = child;
+        version = childVersion;
+    }
+    return node;
+}
+template <class DT>
+bool ConcurrentMTree<DT>::find(const DT& value) { // Determine if a value is within the tree
+    while (true) {
+        unsigned long long version;
+        ConcurrentNode<DT>* node = find_leaf(value, version);
+        if (!node) {
+            continue;
+        }
+        int i = node->position(value);
+        bool found = i < node->count && !(value < node->keys[i]);
+        bool restart = false;
+        node->lock.check(version, restart); // Only trust what was read if no writer touched the leaf meanwhile
+        if (!restart) {
+            return found;
+        }
+    }
+}
+template <class DT>
+bool ConcurrentMTree<DT>::split_child(ConcurrentNode<DT>* parent, unsigned long long& parentVersion, ConcurrentNode<DT>* node, unsigned long long& version) { // Splits a full node
+    bool restart = false;
+    if (parent) {
+        parent->lock.upgrade(parentVersion, restart);
+        if (restart) {
+            return false;
+        }
+    }
+    node->lock.upgrade(version, restart);
+    if (restart || (!parent && node != root.load())) { // Lost a race, or another thread grew the tree above node
+        if (!restart) {
+            node->lock.write_unlock();
+        }
+        if (parent) {
+            parent->lock.write_unlock();
+        }
+        return false;
+    }
+    DT separator;
+    ConcurrentNode<DT>* right = node->split(M, separator);
+    if (parent) { // The parent has room, since full nodes are split on the way down
+        parent->insert_child(separator, right);
+    }
+    else { // node was the root, so the tree grows a level
+        ConcurrentNode<DT>* top = new ConcurrentNode<DT>(M, false);
+        top->keys[0] = separator;
+        top->children[0] = node;
+        top->children[1] = right;
+        top->count = 1;
+        root.store(top);
+    }
+    node->lock.write_unlock();
+    if (parent) {
+        parent->lock.write_unlock();
+    }
+    return true;
+}
+template <class DT>
+bool ConcurrentMTree<DT>::insert(const DT& value) { // Insert a value, returns false if it was already there
+    while (true) {
+        bool restart = false;
+        ConcurrentNode<DT>* node = root.load();
+        unsigned long long version = node->lock.read_lock(restart);
+        if (node != root.load()) {
+            continue;
+        }
+        ConcurrentNode<DT>* parent = nullptr;
+        unsigned long long parentVersion = 0;
+        while (true) {
+            if (node->count == M - 1) { // Full: split it now so its parent never overflows, then start over
+                split_child(parent, parentVersion, node, version);
+                restart = true;
+                break;
+            }
+            if (node->leaf) {
+                break;
+            }
+            parent = node;
+            parentVersion = version;
+            node = parent->children[parent->child_index(value)];
+            parent->lock.check(parentVersion, restart);
+            if (restart) {
+                break;
+            }
+            version = node->lock.read_lock(restart);
+            parent->lock.check(parentVersion, restart); // Catches a split of node between the two reads
+            if (restart) {
+                break;
+            }
+        }
+        if (restart) {
+            continue;
+        }
+
+        node->lock.upgrade(version, restart); // Only the leaf itself is locked
+        if (restart) {
+            continue;
+        }
+        int i = node->position(value);
+        bool added = !(i < node->count && !(value < node->keys[i]));
+        if (added) {
+            for (int j = node->count; j > i; j--) {
+                node->keys[j] = node->keys[j - 1];
+            }
+            node->keys[i] = value;
+            node->count++;
+        }
+        node->lock.write_unlock();
+        return added;
+    }
+}
+template <class DT>
+bool ConcurrentMTree<DT>::remove(const DT& value) { // Delete a value, returns false if it was not there
+    while (true) {
+        unsigned long long version;
+        ConcurrentNode<DT>* node = find_leaf(value, version);
+        if (!node) {
+            continue;
+        }
+        bool restart = false;
+        node->lock.upgrade(version, restart);
+        if (restart) {
+            continue;
+        }
+        int i = node->position(value);
+        bool removed = i < node->count && !(value < node->keys[i]);
+        if (removed) {
+            for (int j = i; j < node->count - 1; j++) {
+                node->keys[j] = node->keys[j + 1];
+            }
+            node->count--;
+        }
+        node->lock.write_unlock();
+        return removed;
+    }
 }
 template <class DT>
-MTree<DT>::~MTree() { // MTree destructor
-    for (int i = 0; i < children.size(); i++) { // Deletes all children's children recursively
-        delete children[i];
+void ConcurrentMTree<DT>::collect_into(ConcurrentNode<DT>* node, vector<DT>& result) { // Append every value below node in order
+    if (node->leaf) {
+        result.insert(result.end(), node->keys, node->keys + node->count);
+        return;
     }
+    for (int i = 0; i <= node->count; i++) {
+        collect_into(node->children[i], result);
+    }
+}
 
-    children.clear();
+// Stress test and throughput benchmark for ConcurrentMTree. Even keys below 2 * keyCount are loaded first and never
+// removed, so every reader lookup of one must succeed. A single writer inserts and removes odd keys, keeping its own
+// record of which are present, and the final tree must match it exactly.
+void concurrentBenchmark(int readers, int M, int keyCount, double seconds) {
+    ConcurrentMTree<int> tree(M);
+    for (int i = 0; i < keyCount; i++) {
+        tree.insert(2 * i);
+    }
+
+    atomic<bool> stop(false);
+    vector<long long> lookups(readers, 0); // Lookups done by each reader
+    atomic<long long> misses(0); // Permanent keys a reader failed to find (must stay 0)
+    long long updates = 0;
+    vector<char> present(keyCount, 0); // Writer's record of which odd keys are in the tree
+    vector<thread> threads;
+    for (int r = 0; r < readers; r++) {
+        threads.push_back(thread([&, r]() {
+            unsigned int seed = 2463534242u + r * 7919;
+            long long done = 0;
+            while (!stop.load(memory_order_relaxed)) {
+                seed ^= seed << 13; // xorshift32
+                seed ^= seed >> 17;
+                seed ^= seed << 5;
+                int key = seed % (2 * keyCount);
+                bool found = tree.find(key);
+                if (key % 2 == 0 && !found) {
+                    misses++;
+                }
+                done++;
+            }
+            lookups[r] = done;
+        }));
+    }
+    thread writer([&]() {
+        unsigned int seed = 88172645u;
+        while (!stop.load(memory_order_relaxed)) {
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            int slot = seed % keyCount;
+            if (present[slot]) {
+                tree.remove(2 * slot + 1);
+            }
+            else {
+                tree.insert(2 * slot + 1);
+            }
+            present[slot] = !present[slot];
+            updates++;
+        }
+    });
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    this_thread::sleep_for(chrono::duration<double>(seconds));
+    stop.store(true);
+    writer.join();
+    for (int r = 0; r < readers; r++) {
+        threads[r].join();
+    }
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    vector<int> expected; // Final contents the writer's record implies
+    for (int i = 0; i < keyCount; i++) {
+        expected.push_back(2 * i);
+        if (present[i]) {
+            expected.push_back(2 * i + 1);
+        }
+    }
+    vector<int> actual;
+    tree.collect_into(tree.root.load(), actual);
+    long long totalLookups = 0;
+    for (int r = 0; r < readers; r++) {
+        totalLookups += lookups[r];
+    }
+
+    cout << "Readers: " << readers << ", M: " << tree.M << ", keys: " << keyCount << ", seconds: " << elapsed << endl;
+    cout << "Lookups: " << totalLookups << " (" << (long long)(totalLookups / elapsed) << " per second)" << endl;
+    cout << "Updates: " << updates << " (" << (long long)(updates / elapsed) << " per second)" << endl;
+    cout << "Missed permanent keys: " << misses.load() << endl;
+    cout << "Final contents " << (actual == expected ? "match" : "do not match") << " the writer's record." << endl;
 }
-template <class DT>
-bool MTree<DT>::isLeaf() const { // Check if the current node is a leaf
-    if (children.size() < 1) { // Uses the size of the nodes children vector
-        return true; // If node has less than 1 children (mostly equivalent to 0) return true
+
+// Hardware cache-miss counter for the calling thread, read through perf_event_open. Where the kernel or the sandbox does
+// not allow it (or off Linux), available() is false and the benchmark prints "-" instead of a count.
+class CacheMissCounter {
+    public:
+        int fd; // perf event, -1 when unavailable
+        CacheMissCounter(); // Opens the counter (disabled)
+        ~CacheMissCounter(); // Closes it
+        bool available() const; // Whether counts can be read
+        void start(); // Resets and enables the counter
+        long long stop(); // Disables the counter and returns the misses since start (-1 when unavailable)
+};
+CacheMissCounter::CacheMissCounter() { // Opens the counter (disabled)
+    fd = -1;
+#ifdef __linux__
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+}
+CacheMissCounter::~CacheMissCounter() { // Closes it
+    if (fd >= 0) {
+        close(fd);
     }
-    return false; // If node has greater than or equal to 1 children then it is not a leaf node
 }
-template <class DT>
-bool MTree<DT>::insert(DT& value) { // Insert a value into the MTree
-    if (find(value)) { // Determines if value is already within MTree
-        return false; // Returns false to verify the value was not inserted
+bool CacheMissCounter::available() const { // Whether counts can be read
+    return fd >= 0;
+}
+void CacheMissCounter::start() { // Resets and enables the counter
+#ifdef __linux__
+    if (fd >= 0) {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
     }
-    vector<DT> temp = collect_values(); // Grabs values and stores them within temp
-
-    // sort(temp.begin(), temp.end()); // Sorts all of the values in the temp vector
-    bool inserted = false;
-    for (int i = 0; i < temp.size() - 1; i++) {
-        if (temp[i] < value && temp[i+1] > value) {
-            int pos = i + 1;
-            temp.insert(temp.begin() + pos, value);
-            break;
+#endif
+}
+long long CacheMissCounter::stop() { // Disables the counter and returns the misses since start
+    long long count = -1;
+#ifdef __linux__
+    if (fd >= 0) {
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(fd, &count, sizeof(count)) != sizeof(count)) {
+            count = -1;
         }
     }
+#endif
+    return count;
+}
+
+// Zipfian ranks over [0, n) with skew theta, by the constant-time inversion from Gray et al., "Quickly Generating
+// Billion-Record Synthetic Databases" (the generator YCSB uses). Rank 0 is the most frequent.
+class ZipfGenerator {
+    public:
+        long long n; // Number of ranks
+        double theta, alpha, zetan, eta; // Skew and precomputed constants
+        ZipfGenerator(long long n, double theta); // Constructor, O(n) to sum the zeta constant
+        long long next(double u) const; // Rank for a uniform u in [0, 1)
+};
+ZipfGenerator::ZipfGenerator(long long n, double theta) { // Constructor
+    (*this).n = n;
+    (*this).theta = theta;
+    zetan = 0;
+    for (long long i = 1; i <= n; i++) {
+        zetan += 1.0 / pow((double)i, theta);
+    }
+    double zeta2 = 1.0 + 1.0 / pow(2.0, theta);
+    alpha = 1.0 / (1.0 - theta);
+    eta = (1.0 - pow(2.0 / n, 1.0 - theta)) / (1.0 - zeta2 / zetan);
+}
+long long ZipfGenerator::next(double u) const { // Rank for a uniform u in [0, 1)
+    double uz = u * zetan;
+    if (uz < 1.0) {
+        return 0;
+    }
+    if (uz < 1.0 + pow(0.5, theta)) {
+        return 1;
+    }
+    long long rank = (long long)(n * pow(eta * u - eta + 1.0, alpha));
+    return rank < n ? rank : n - 1;
+}
 
-    if (!inserted) {
-        if (temp.empty() || temp.back() < value) {
-            temp.push_back(value);
+// count keys from the domain [0, 4 * count) for one benchmark stream. Sequential keys ascend; uniform keys are
+// independent draws; Zipfian keys repeat a few hot keys often (theta 0.99), scattered over the domain by a multiplicative
+// hash so the hot keys do not all sit in one leaf.
+vector<int> benchmarkKeys(const string& distribution, int count, unsigned int seed) {
+    vector<int> keys(count);
+    unsigned long long state = seed * 0x9e3779b97f4a7c15ULL + 1;
+    long long domain = 4LL * count;
+    ZipfGenerator* zipf = distribution == "zipf" ? new ZipfGenerator(domain, 0.99) : nullptr;
+    for (int i = 0; i < count; i++) {
+        state ^= state << 13; // xorshift64
+        state ^= state >> 7;
+        state ^= state << 17;
+        if (distribution == "sequential") {
+            keys[i] = 4 * i;
+        }
+        else if (zipf) {
+            long long rank = zipf->next((state >> 11) * (1.0 / 9007199254740992.0));
+            keys[i] = (int)((unsigned long long)rank * 2654435761ULL % domain);
+        }
+        else {
+            keys[i] = (int)(state % domain);
         }
     }
+    delete zipf;
+    return keys;
+}
 
-    buildTree(temp); // Builds a new tree given the temp vector
-    return true; // Returns true to verify that the value was inserted
+// Prints one result row: the time and misses are divided by ops, the memory by the number of keys in the tree.
+void benchmarkRow(const string& distribution, int size, int M, const char* op, double seconds, long long misses, long long ops, size_t bytes, int keys) {
+    char line[160];
+    char missText[32] = "-";
+    if (misses >= 0) {
+        snprintf(missText, sizeof(missText), "%.2f", (double)misses / ops);
+    }
+    char byteText[32] = "-";
+    if (keys > 0) {
+        snprintf(byteText, sizeof(byteText), "%.1f", (double)bytes / keys);
+    }
+    snprintf(line, sizeof(line), "%-10s %9d %5d  %-10s %10.1f %10s %10s", distribution.c_str(), size, M, op, seconds * 1e9 / ops, missText, byteText);
+    cout << line << endl;
 }
-template <class DT>
-void MTree<DT>::split_node() { // Split the node if it exceeds capacity
-    if (values.size() < M) { // If the values are less than M, then nothing should be done
-        return;
+
+// Sweeps M, tree size and key distribution and times each operation of MTree on its own:
+//   bulk-build  buildTree from the stream's distinct keys, sorted
+//   find        size lookups drawn from the same distribution (the routed search, not the packed copy)
+//   range       size / 64 lower_bound calls, each followed by 64 steps of the iterator
+//   insert      the whole stream into an empty tree, one insert at a time
+//   remove      every key of that tree, in stream order
+// Each row gives ns/op, last-level cache misses per op when perf counters can be read, and the heap bytes per key of the
+// tree the operation built (bulk-build, insert) or ran on. Sizes go up by 10x from 1000 to maxKeys.
+void treeBenchmark(int maxKeys, int maxM) {
+    CacheMissCounter counter;
+    const char* distributions[] = {"uniform", "sequential", "zipf"};
+    vector<int> Ms;
+    for (int M = 3; M <= maxM; M = M == 3 ? 4 : 2 * M) {
+        Ms.push_back(M);
     }
+    vector<int> sizes;
+    for (int size = 1000; size < maxKeys; size *= 10) {
+        sizes.push_back(size);
+    }
+    sizes.push_back(maxKeys);
+
+    char header[160];
+    snprintf(header, sizeof(header), "%-10s %9s %5s  %-10s %10s %10s %10s", "keys", "size", "M", "op", "ns/op", "misses/op", "bytes/key");
+    cout << header << endl;
+    long long checksum = 0; // Keeps the compiler from dropping lookups whose result is unused
+    for (int d = 0; d < 3; d++) {
+        for (int s = 0; s < (int)sizes.size(); s++) {
+            int size = sizes[s];
+            vector<int> stream = benchmarkKeys(distributions[d], size, 1);
+            vector<int> queries = benchmarkKeys(distributions[d], size, 2);
+            vector<int> sorted(stream);
+            sort(sorted.begin(), sorted.end());
+            sorted.erase(unique(sorted.begin(), sorted.end()), sorted.end());
+            for (int m = 0; m < (int)Ms.size(); m++) {
+                int M = Ms[m];
+                chrono::steady_clock::time_point start;
+                double seconds;
+                long long misses;
+
+                MTree<int> built(M);
+                counter.start();
+                start = chrono::steady_clock::now();
+                built.buildTree(sorted);
+                seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+                misses = counter.stop();
+                benchmarkRow(distributions[d], size, M, "bulk-build", seconds, misses, sorted.size(), built.memory_usage(), sorted.size());
+
+                counter.start();
+                start = chrono::steady_clock::now();
+                for (int i = 0; i < size; i++) {
+                    checksum += built.search(queries[i]);
+                }
+                seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+                misses = counter.stop();
+                benchmarkRow(distributions[d], size, M, "find", seconds, misses, size, built.memory_usage(), sorted.size());
 
-    int splitSize = values.size() / M; // Determines the size for each split
-    vector<DT> tempValues = values; // Stores the current values temporarily
-    values.clear(); // Clears the current values to redistribute them into child nodes
+                int ranges = size / 64 > 0 ? size / 64 : 1;
+                counter.start();
+                start = chrono::steady_clock::now();
+                for (int i = 0; i < ranges; i++) {
+                    MTree<int>::iterator it = built.lower_bound(queries[i]);
+                    for (int j = 0; j < 64 && it != built.end(); j++, ++it) {
+                        checksum += *it;
+                    }
+                }
+                seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+                misses = counter.stop();
+                benchmarkRow(distributions[d], size, M, "range", seconds, misses, ranges, built.memory_usage(), sorted.size());
 
-    for (int i = 0; i < M; i++) { // Creates M children
-        int start = i * splitSize; // Starting index for this child's values
-        int end = (i == M - 1) ? tempValues.size() : (i + 1) * splitSize; // Handles the last child differently to include all remaining values
+                MTree<int> grown(M);
+                counter.start();
+                start = chrono::steady_clock::now();
+                for (int i = 0; i < size; i++) {
+                    checksum += grown.insert(stream[i]);
+                }
+                seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+                misses = counter.stop();
+                benchmarkRow(distributions[d], size, M, "insert", seconds, misses, size, grown.memory_usage(), sorted.size());
 
-        vector<DT> childValues(tempValues.begin() + start, tempValues.begin() + end); // Extracts a portion of values for this child
+                size_t grownBytes = grown.memory_usage();
+                vector<char> removed(4LL * size, 0); // The stream repeats keys, each is removed once
+                long long removes = 0;
+                counter.start();
+                start = chrono::steady_clock::now();
+                for (int i = 0; i < size; i++) {
+                    if (!removed[stream[i]]) {
+                        removed[stream[i]] = 1;
+                        grown.remove(stream[i]);
+                        removes++;
+                    }
+                }
+                seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+                misses = counter.stop();
+                benchmarkRow(distributions[d], size, M, "remove", seconds, misses, removes, grownBytes, sorted.size());
+            }
+        }
+    }
+    if (!counter.available()) {
+        cout << "(cache misses need perf_event_open, which is not available here)" << endl;
+    }
+    cerr << "checksum " << checksum << endl;
+}
 
-        MTree<DT>* child = new MTree<DT>(M); // Creates a new child node
-        child->values = childValues; // Assigns values to the child
-        children.push_back(child); // Adds the child to the current node's children
+// Fixed-size page cache in front of an index file. Frames are taken over with the CLOCK policy: the hand sweeps the
+// frames, sparing pinned ones and giving each recently used one a second chance, so hot pages (the upper levels of a tree)
+// stay in memory and cold ones are dropped. Dirty pages are not written one at a time on eviction. Instead, up to
+// WRITE_BATCH of them go out together, in page order, with runs of neighbouring pages merged into a single pwrite.
+class BufferPool {
+    public:
+        static const int PAGE = 4096; // Page size in bytes
+        static const int WRITE_BATCH = 64; // Most dirty pages written back per eviction
+        int fd; // Index file
+        int capacity; // Number of frames (memory cap / PAGE)
+        char* frames; // capacity page frames, frame f starts at frames + f * PAGE
+        vector<long long> pageOf; // Page held by each frame, -1 when free
+        vector<char> dirty; // Frame changed since it was read or written
+        vector<char> referenced; // CLOCK bit, set on every use
+        vector<int> pins; // Users currently holding each frame (pinned frames are never evicted)
+        unordered_map<long long, int> frameOf; // Frame holding each cached page
+        int hand; // CLOCK hand
+        long long pageCount; // Pages in the file, including pages not yet written
+        long long hits, misses, pageWrites; // Counters for tuning the pool size
+        BufferPool(int fd, int capacity, long long pageCount); // Constructor
+        ~BufferPool(); // Destructor (does not flush, the owner decides when)
+        char* pin(long long page); // Returns page's frame, reading it in if needed, and keeps it in memory until unpinned
+        char* pin_new(long long& page); // Appends a zeroed page to the file and pins it
+        void unpin(long long page, bool changed); // Releases a pinned page, marking it dirty if it was changed
+        int victim(); // Frees a frame for a new page
+        void write_back(int first); // Writes frame first and other unpinned dirty frames in one batch
+        void flush(); // Writes every dirty frame
+        void reset(long long pages); // Drops every frame and truncates the file to its first pages
+};
+BufferPool::BufferPool(int fd, int capacity, long long pageCount) { // Constructor
+    (*this).fd = fd;
+    (*this).capacity = capacity < 8 ? 8 : capacity; // A tree operation pins at most four pages at once
+    (*this).pageCount = pageCount;
+    void* memory;
+    if (posix_memalign(&memory, PAGE, (size_t)(*this).capacity * PAGE) != 0) {
+        throw bad_alloc();
     }
+    frames = (char*)memory;
+    pageOf.assign((*this).capacity, -1);
+    dirty.assign((*this).capacity, 0);
+    referenced.assign((*this).capacity, 0);
+    pins.assign((*this).capacity, 0);
+    hand = 0;
+    hits = misses = pageWrites = 0;
 }
-template <class DT>
-MTree<DT>* MTree<DT>::find_child(const DT& value) { // Find child
-    for (int i = 0; i < values.size(); i++) { // Iterates through the current node's values
-        if (value < values[i]) { // If the value is less than the current value
-            return children[i]; // Return the corresponding child
+BufferPool::~BufferPool() { // Destructor
+    free(frames);
+}
+char* BufferPool::pin(long long page) { // Returns page's frame, reading it in if needed
+    unordered_map<long long, int>::iterator cached = frameOf.find(page);
+    int f;
+    if (cached != frameOf.end()) {
+        f = cached->second;
+        hits++;
+    }
+    else {
+        f = victim();
+        if (pread(fd, frames + (size_t)f * PAGE, PAGE, page * PAGE) != PAGE) {
+            throw DiskIOException("Could not read a page of the index file.");
         }
+        pageOf[f] = page;
+        frameOf[page] = f;
+        misses++;
     }
-    return children[children.size() - 1]; return children[children.size() - 1]; // If no smaller value is found, return the last child
+    referenced[f] = 1;
+    pins[f]++;
+    return frames + (size_t)f * PAGE;
 }
-template <class DT>
-bool MTree<DT>::search(const DT& value) { // Search for a value in the MTree
-    for (int i = 0; i < values.size(); i++) { // Check current node's values
-        if (values[i] == value) { // If the value is found
-            return true; // Return true to indicate value found
+char* BufferPool::pin_new(long long& page) { // Appends a zeroed page to the file and pins it
+    int f = victim();
+    page = pageCount++;
+    memset(frames + (size_t)f * PAGE, 0, PAGE);
+    pageOf[f] = page;
+    frameOf[page] = f;
+    dirty[f] = 1; // Has to reach the file even if nobody writes to it
+    referenced[f] = 1;
+    pins[f]++;
+    return frames + (size_t)f * PAGE;
+}
+void BufferPool::unpin(long long page, bool changed) { // Releases a pinned page
+    int f = frameOf[page];
+    pins[f]--;
+    if (changed) {
+        dirty[f] = 1;
+    }
+}
+int BufferPool::victim() { // Frees a frame for a new page
+    for (int sweep = 0; sweep < 3 * capacity; sweep++) { // Two passes clear every CLOCK bit, the third must find a frame
+        int f = hand;
+        hand = (hand + 1) % capacity;
+        if (pageOf[f] < 0) {
+            return f;
+        }
+        if (pins[f] > 0) {
+            continue;
         }
+        if (referenced[f]) { // Second chance
+            referenced[f] = 0;
+            continue;
+        }
+        if (dirty[f]) {
+            write_back(f);
+        }
+        frameOf.erase(pageOf[f]);
+        pageOf[f] = -1;
+        return f;
     }
-
-    if (isLeaf()) { // If the current node is a leaf
-        return false; // The value is not found
+    throw DiskIOException("Every page in the buffer pool is pinned.");
+}
+void BufferPool::write_back(int first) { // Writes frame first and other unpinned dirty frames in one batch
+    vector<pair<long long, int> > batch; // (page, frame), written in page order
+    batch.push_back(make_pair(pageOf[first], first));
+    for (int i = 1; i < capacity && (int)batch.size() < WRITE_BATCH; i++) {
+        int f = (first + i) % capacity;
+        if (pageOf[f] >= 0 && dirty[f] && pins[f] == 0) {
+            batch.push_back(make_pair(pageOf[f], f));
+        }
     }
+    sort(batch.begin(), batch.end());
 
-    MTree<DT>* child = find_child(value); // Determine which child might contain the value
-    if (child) { // If a valid child is found
-        return child->search(value); // Recursively search in the child
+    vector<char> run; // Consecutive pages copied together so they go out in one call
+    for (int i = 0; i < (int)batch.size();) {
+        int j = i + 1;
+        while (j < (int)batch.size() && batch[j].first == batch[j - 1].first + 1) {
+            j++;
+        }
+        run.resize((size_t)(j - i) * PAGE);
+        for (int k = i; k < j; k++) {
+            memcpy(&run[(size_t)(k - i) * PAGE], frames + (size_t)batch[k].second * PAGE, PAGE);
+            dirty[batch[k].second] = 0;
+        }
+        if (pwrite(fd, &run[0], run.size(), batch[i].first * PAGE) != (ssize_t)run.size()) {
+            throw DiskIOException("Could not write a page of the index file.");
+        }
+        pageWrites += j - i;
+        i = j;
     }
-
-    return false; // If no valid child is found, return false
 }
-template <class DT>
-void MTree<DT>::remove(const DT& value) { // Delete a value from the MTree
-    vector<DT> temp = (*this).collect_values(); // Collect all values from the true into a temp vector
-    bool found = false; // Placeholder for whether or not value is found
-    for (int i = 0; i < temp.size(); i++) { // Iterate through the collected values
-        if (temp[i] == value) { // If the value to be removed is found
-            found = true; // Set found to true
-            for (int j = i; j < temp.size() - 1; j++) { // Shift subsequent values to overwrite the found value
-                temp[j] = temp[j + 1];
-            }
-            temp.pop_back(); // Remove the last value (now a duplicate due to shifting)
-            break; // Exit the loop since the value is found and removed
+void BufferPool::flush() { // Writes every dirty frame
+    for (int f = 0; f < capacity; f++) {
+        if (pageOf[f] >= 0 && dirty[f]) {
+            write_back(f);
         }
     }
-
-    if (!found) { // If the value was not found in the tree
-        throw NotFoundException(); // Throw a NotFoundException to indicate an error
+}
+void BufferPool::reset(long long pages) { // Drops every frame and truncates the file to its first pages
+    pageOf.assign(capacity, -1);
+    dirty.assign(capacity, 0);
+    referenced.assign(capacity, 0);
+    frameOf.clear();
+    pageCount = pages;
+    if (ftruncate(fd, pages * PAGE) != 0) {
+        throw DiskIOException("Could not truncate the index file.");
     }
+}
 
-    buildTree(temp); // Rebuild the tree with the updated values after removal
+// View of an MTree node stored in a page: a small header, then up to M - 1 keys, then (internal nodes only) M child page
+// numbers. Leaves keep every key and link to the next leaf, as in MTree; an internal node routes value to the child after
+// the last separator <= value.
+template <class DT>
+class DiskNode {
+    public:
+        static const int HEADER = 16; // leaf flag, key count, next leaf
+        char* page; // Frame holding the node
+        int M; // Order of the tree the node belongs to
+        DiskNode(char* page, int M); // Constructor
+        int& leaf(); // 1 for leaves
+        int& count(); // Number of keys
+        long long& next(); // Page of the next leaf, -1 for the last one
+        DT* keys(); // Sorted keys or separators
+        long long* children(); // count() + 1 child pages of an internal node
+        int child_index(const DT& value); // Number of separators <= value
+        int position(const DT& value); // Number of keys < value
+        static int keys_end(int M); // Offset where the children start
+        static int max_order(); // Largest M whose node fits in a page
+};
+template <class DT>
+DiskNode<DT>::DiskNode(char* page, int M) { // Constructor
+    (*this).page = page;
+    (*this).M = M;
 }
 template <class DT>
-void MTree<DT>::buildTree(vector<DT>& input_values) { // Build the tree given a vector of values
-
-    values.clear(); // Clear the current node's values
-    for (int i = 0; i < children.size(); i++) { // Delete all child nodes
-        delete children[i];
+int& DiskNode<DT>::leaf() { // 1 for leaves
+    return *(int*)page;
+}
+template <class DT>
+int& DiskNode<DT>::count() { // Number of keys
+    return *(int*)(page + 4);
+}
+template <class DT>
+long long& DiskNode<DT>::next() { // Page of the next leaf
+    return *(long long*)(page + 8);
+}
+template <class DT>
+DT* DiskNode<DT>::keys() { // Sorted keys or separators
+    return (DT*)(page + HEADER);
+}
+template <class DT>
+long long* DiskNode<DT>::children() { // Child pages of an internal node
+    return (long long*)(page + keys_end(M));
+}
+template <class DT>
+int DiskNode<DT>::child_index(const DT& value) { // Number of separators <= value
+    return std::upper_bound(keys(), keys() + count(), value) - keys();
+}
+template <class DT>
+int DiskNode<DT>::position(const DT& value) { // Number of keys < value
+    return std::lower_bound(keys(), keys() + count(), value) - keys();
+}
+template <class DT>
+int DiskNode<DT>::keys_end(int M) { // Offset where the children start, rounded up for alignment
+    return (HEADER + (M - 1) * (int)sizeof(DT) + 7) / 8 * 8;
+}
+template <class DT>
+int DiskNode<DT>::max_order() { // Largest M whose node fits in a page
+    int M = 3;
+    while (keys_end(M + 1) + (M + 1) * (int)sizeof(long long) <= BufferPool::PAGE) {
+        M++;
     }
-    children.clear(); // Clear the children vector
+    return M;
+}
 
-    if (input_values.size() <= M - 1) { // If the input values fit within a single node
-        values = input_values; // Assign them to the current node
-        return;
+// MTree stored as fixed-size pages in a file, so the number of keys is limited by the disk and not by memory. Nodes are
+// only reached through the buffer pool, which keeps at most poolPages of them in memory. Page 0 holds a header with the
+// order, root page and key count, so opening an existing file picks the tree up where it was left without a rebuild.
+// Pages are overwritten in place, so the header also carries a dirty flag: it is set (and synced) before the first page
+// of a session can reach the file, and cleared only by flush, after every page is synced. A file opened with the flag
+// still set was not closed cleanly and may hold a torn tree, so it is rejected instead of trusted.
+// Like ConcurrentMTree, full nodes are split on the way down and removal does not merge under-full leaves; a rebuild (B)
+// packs the file again. Keys must be plain bytes (trivially copyable), since they are copied to and from the file as is.
+template <class DT>
+class DiskMTree {
+    static_assert(is_trivially_copyable<DT>::value, "DiskMTree keys are stored as raw bytes");
+    public:
+        static const long long MAGIC = 0x3145474150544d4dLL; // "MMTPAGE1"
+        int fd; // Index file
+        bool dirty; // The header in the file has its dirty flag set
+        int M; // Maximum number of children per node
+        long long root; // Page of the root node
+        long long size; // Number of keys
+        BufferPool* pool; // Page cache through which every node is read and written
+        DiskMTree(const string& path, int M, int poolPages); // Opens the index at path, or creates it if the file is empty
+        ~DiskMTree(); // Writes everything back (if it still can) and closes the file
+        bool reopened() const; // True if the file already held a tree when it was opened
+        void write_header(bool clean); // Stores order, root, size and the dirty flag in page 0
+        void mark_dirty(); // Sets the dirty flag in the file before this session's first page write
+        void flush(); // Makes the file hold the whole tree, durably, and clears the dirty flag
+        bool find(const DT& value); // Determine if a value is within the tree
+        bool insert(const DT& value); // Insert a value, returns false if it was already there
+        void remove(const DT& value); // Delete a value (throws NotFoundException)
+        long long split(DiskNode<DT>& node, DT& separator); // Moves the upper half of a full node into a new page
+        long long leaf_for(const DT& value); // Page of the leaf whose range holds value
+        void buildTree(vector<DT>& input_values); // Rebuild the file bottom-up from sorted, distinct values
+        template <class Iter>
+        int bulk_merge(Iter first, Iter last); // Insert a sorted batch, returns how many were new
+        vector<DT> collect_values(); // Every value in order, read along the leaf links
+        class iterator { // Forward iterator along the leaf links, holding a copy of the current key
+            public:
+                DiskMTree* tree; // Tree being walked
+                long long leaf; // Current leaf page, -1 at the end
+                int index; // Position of the current key in the leaf
+                DT key; // Copy of the current key
+                iterator(DiskMTree* tree, long long leaf, int index); // Positions at index, moving on to later leaves if past the end
+                void settle(); // Skips to the first key at or after (leaf, index)
+                const DT& operator*() const; // Current key
+                iterator& operator++(); // Advance to the next key
+                bool operator==(const iterator& other) const;
+                bool operator!=(const iterator& other) const;
+        };
+        iterator lower_bound(const DT& value); // First key >= value
+        iterator end(); // Past the last key
+    private:
+        bool existed; // File held a tree when opened
+};
+template <class DT>
+const long long DiskMTree<DT>::MAGIC;
+template <class DT>
+DiskMTree<DT>::DiskMTree(const string& path, int M, int poolPages) { // Opens the index at path, or creates it
+    fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        throw DiskIOException("Could not open the index file.");
     }
-    else {
-        int D = input_values.size() / M; // Determine the size of each partition
-        for (int i = 0; i < M; i++) { // Create M children
-            int start = D * i; // Starting index for this partition
-            int end;
-            if (i == M - 1) { // Handle the last partition
-                end = input_values.size() -1;
-            }
-            else {
-                end = start + D - 1;
-                values.push_back(input_values[end]); // Store a boundary value in the current node
-            }
-            vector<DT> child_values(input_values.begin() + start, input_values.begin() + end + 1); // Extra partition values
-            MTree<DT>* child = new MTree<DT>(M); // Create a new child node
-            child->buildTree(child_values); // Recursively build the child
-            children.push_back(child); // Add the child to the current node
+    struct stat info;
+    fstat(fd, &info);
+    long long header[6]; // magic, key size, order, root, size, dirty flag
+    existed = info.st_size >= BufferPool::PAGE;
+    dirty = false;
+    if (existed) { // Pick up the tree the file already holds
+        if (pread(fd, header, sizeof(header), 0) != (ssize_t)sizeof(header) || header[0] != MAGIC || header[1] != (long long)sizeof(DT)) {
+            close(fd);
+            throw DiskIOException("The file is not an index of this key type.");
         }
+        if (header[5] != 0) {
+            close(fd);
+            throw DiskIOException("The index file was not closed cleanly and may be damaged. Delete it to rebuild the index.");
+        }
+        (*this).M = (int)header[2];
+        root = header[3];
+        size = header[4];
+        pool = new BufferPool(fd, poolPages, info.st_size / BufferPool::PAGE);
+    }
+    else { // Start a new tree with one empty leaf
+        (*this).M = M < 3 ? 3 : (M > DiskNode<DT>::max_order() ? DiskNode<DT>::max_order() : M);
+        size = 0;
+        pool = new BufferPool(fd, poolPages, 1);
+        root = 1; // The leaf pin_new is about to append
+        mark_dirty();
+        DiskNode<DT> node(pool->pin_new(root), (*this).M);
+        node.leaf() = 1;
+        node.next() = -1;
+        pool->unpin(root, true);
     }
 }
 template <class DT>
-vector<DT> MTree<DT>::collect_values() { // Collect values from all leaf nodes
-    vector<DT> result; // Stores the collected values
-
-    for (int i = 0; i < M; i++) { // Iterates through all children
-        if (children[i]->isLeaf()) { // If the child is a leaf
-            int value;
-            for (int j = 0; j < children[i]->values.size(); j++) { // Collect all values from the leaf
-                value = children[i]->values[j];
-                result.push_back(value); // Add each value to the result
-            }
+DiskMTree<DT>::~DiskMTree() { // Writes everything back (if it still can) and closes the file
+    try { // Callers that care about write errors call flush themselves; the dirty flag stays set if this one fails
+        flush();
+    } catch (DiskIOException&) {
+    }
+    delete pool;
+    close(fd);
+}
+template <class DT>
+bool DiskMTree<DT>::reopened() const { // True if the file already held a tree when it was opened
+    return existed;
+}
+template <class DT>
+void DiskMTree<DT>::write_header(bool clean) { // Stores order, root, size and the dirty flag in page 0
+    long long header[6] = {MAGIC, (long long)sizeof(DT), M, root, size, clean ? 0 : 1};
+    if (pwrite(fd, header, sizeof(header), 0) != (ssize_t)sizeof(header) || fdatasync(fd) != 0) {
+        throw DiskIOException("Could not write the index header.");
+    }
+}
+template <class DT>
+void DiskMTree<DT>::mark_dirty() { // Sets the dirty flag in the file before this session's first page write
+    if (!dirty) {
+        write_header(false); // Synced, so no page write can reach the file ahead of it
+        dirty = true;
+    }
+}
+template <class DT>
+void DiskMTree<DT>::flush() { // Makes the file hold the whole tree, durably, and clears the dirty flag
+    if (!dirty) { // Nothing has changed since the file was last clean
+        return;
+    }
+    pool->flush();
+    if (fdatasync(fd) != 0) { // Every page is in the file before the header may say the tree is whole
+        throw DiskIOException("Could not write a page of the index file.");
+    }
+    write_header(true);
+    dirty = false;
+}
+template <class DT>
+long long DiskMTree<DT>::leaf_for(const DT& value) { // Page of the leaf whose range holds value
+    long long page = root;
+    while (true) {
+        DiskNode<DT> node(pool->pin(page), M);
+        if (node.leaf()) {
+            pool->unpin(page, false);
+            return page;
         }
-        else {
-            vector<DT> result2 = children[i]->collect_values(); // Recursively collect values from non-leaf children
-            for (int j = 0; j < result2.size(); j++) { // Add these values to the result
-                result.push_back(result2[j]);
+        long long child = node.children()[node.child_index(value)];
+        pool->unpin(page, false);
+        page = child;
+    }
+}
+template <class DT>
+bool DiskMTree<DT>::find(const DT& value) { // Determine if a value is within the tree
+    long long page = leaf_for(value);
+    DiskNode<DT> node(pool->pin(page), M);
+    int i = node.position(value);
+    bool found = i < node.count() && !(value < node.keys()[i]);
+    pool->unpin(page, false);
+    return found;
+}
+template <class DT>
+long long DiskMTree<DT>::split(DiskNode<DT>& node, DT& separator) { // Moves the upper half of a full node into a new page
+    long long rightPage;
+    DiskNode<DT> right(pool->pin_new(rightPage), M);
+    right.leaf() = node.leaf();
+    int half = node.count() / 2;
+    if (node.leaf()) { // Leaves keep every key, the parent gets a copy of the first key on the right
+        right.count() = node.count() - half;
+        memcpy(right.keys(), node.keys() + half, right.count() * sizeof(DT));
+        separator = right.keys()[0];
+        right.next() = node.next();
+        node.next() = rightPage;
+    }
+    else { // The middle separator moves up
+        separator = node.keys()[half];
+        right.count() = node.count() - half - 1;
+        right.next() = -1;
+        memcpy(right.keys(), node.keys() + half + 1, right.count() * sizeof(DT));
+        memcpy(right.children(), node.children() + half + 1, (right.count() + 1) * sizeof(long long));
+    }
+    node.count() = half;
+    pool->unpin(rightPage, true);
+    return rightPage;
+}
+template <class DT>
+bool DiskMTree<DT>::insert(const DT& value) { // Insert a value, returns false if it was already there
+    mark_dirty();
+    long long page = root;
+    DiskNode<DT> node(pool->pin(page), M);
+    if (node.count() == M - 1) { // Full root: the tree grows a level first
+        DT separator;
+        long long rightPage = split(node, separator);
+        long long topPage;
+        DiskNode<DT> top(pool->pin_new(topPage), M);
+        top.leaf() = 0;
+        top.count() = 1;
+        top.next() = -1;
+        top.keys()[0] = separator;
+        top.children()[0] = page;
+        top.children()[1] = rightPage;
+        pool->unpin(page, true);
+        root = topPage;
+        page = topPage;
+        node = top;
+    }
+    bool changed = false; // node was split or got a separator, so its page is dirty
+    while (!node.leaf()) { // node is pinned and has room for one more separator
+        int i = node.child_index(value);
+        long long childPage = node.children()[i];
+        DiskNode<DT> child(pool->pin(childPage), M);
+        bool childChanged = false;
+        if (child.count() == M - 1) { // Split full nodes on the way down, so a split never has to climb back up
+            DT separator;
+            long long rightPage = split(child, separator);
+            memmove(node.keys() + i + 1, node.keys() + i, (node.count() - i) * sizeof(DT));
+            memmove(node.children() + i + 2, node.children() + i + 1, (node.count() - i) * sizeof(long long));
+            node.keys()[i] = separator;
+            node.children()[i + 1] = rightPage;
+            node.count()++;
+            changed = true;
+            childChanged = true;
+            if (!(value < separator)) { // Continue in the new right half
+                pool->unpin(childPage, true);
+                childPage = rightPage;
+                child = DiskNode<DT>(pool->pin(childPage), M);
+                childChanged = false;
             }
         }
+        pool->unpin(page, changed);
+        page = childPage;
+        node = child;
+        changed = childChanged;
     }
 
-    return result; // Return all collected values
+    int i = node.position(value);
+    bool added = !(i < node.count() && !(value < node.keys()[i]));
+    if (added) {
+        memmove(node.keys() + i + 1, node.keys() + i, (node.count() - i) * sizeof(DT));
+        node.keys()[i] = value;
+        node.count()++;
+        size++;
+    }
+    pool->unpin(page, added || changed);
+    return added;
+}
+template <class DT>
+void DiskMTree<DT>::remove(const DT& value) { // Delete a value (throws NotFoundException)
+    long long page = leaf_for(value);
+    DiskNode<DT> node(pool->pin(page), M);
+    int i = node.position(value);
+    if (i == node.count() || value < node.keys()[i]) {
+        pool->unpin(page, false);
+        throw NotFoundException();
+    }
+    mark_dirty();
+    memmove(node.keys() + i, node.keys() + i + 1, (node.count() - i - 1) * sizeof(DT));
+    node.count()--;
+    size--;
+    pool->unpin(page, true);
 }
+// Leaves are written first, full and in key order, so they take up consecutive pages and each one's next leaf is simply
+// the following page; each level above is then built from the one below, M children per node.
 template <class DT>
-bool MTree<DT>::find(DT& value) { // Determine if a value is within the tree
-    
-    for (int i = 0; i < M; i++) { // Iterates through all children
-        if (children[i]->isLeaf()) { // If the child is a leaf
-            int x;
-            for (int j = 0; j < children[i]->values.size(); j++) { // Search all values in the leaf
-                x = children[i]->values[j];
-                if (x == value) { // If the value is found
-                    return true; // Return true
+void DiskMTree<DT>::buildTree(vector<DT>& input_values) { // Rebuild the file bottom-up from sorted, distinct values
+    mark_dirty();
+    pool->reset(1);
+    vector<pair<long long, DT> > level; // (page, first key) of every node of the level just built
+    int n = input_values.size();
+    int perLeaf = M - 1;
+    for (int start = 0; start < n || level.empty(); start += perLeaf) {
+        long long page;
+        DiskNode<DT> leaf(pool->pin_new(page), M);
+        leaf.leaf() = 1;
+        leaf.count() = min(perLeaf, n - start);
+        leaf.next() = start + perLeaf < n ? page + 1 : -1;
+        if (leaf.count() > 0) {
+            memcpy(leaf.keys(), &input_values[start], leaf.count() * sizeof(DT));
+        }
+        level.push_back(make_pair(page, leaf.count() > 0 ? leaf.keys()[0] : DT()));
+        pool->unpin(page, true);
+    }
+    while (level.size() > 1) {
+        vector<pair<long long, DT> > above;
+        for (int start = 0; start < (int)level.size(); start += M) {
+            int children = min(M, (int)level.size() - start);
+            long long page;
+            DiskNode<DT> node(pool->pin_new(page), M);
+            node.leaf() = 0;
+            node.count() = children - 1;
+            node.next() = -1;
+            for (int c = 0; c < children; c++) {
+                node.children()[c] = level[start + c].first;
+                if (c > 0) {
+                    node.keys()[c - 1] = level[start + c].second;
                 }
             }
+            above.push_back(make_pair(page, level[start].second));
+            pool->unpin(page, true);
         }
-        else {
-            if (children[i]->find(value)) { // Recursively search in non-leaf children
-                return true; // If found in a child, return true
-            }
+        level.swap(above);
+    }
+    root = level[0].first;
+    size = n;
+    flush();
+}
+template <class DT>
+template <class Iter>
+int DiskMTree<DT>::bulk_merge(Iter first, Iter last) { // Insert a sorted batch, returns how many were new
+    int added = 0;
+    for (; first != last; ++first) { // Consecutive keys mostly land in the leaf just read, which the pool still holds
+        if (insert(*first)) {
+            added++;
         }
     }
-
-    return false; // Return false if the value is not found
+    return added;
+}
+template <class DT>
+vector<DT> DiskMTree<DT>::collect_values() { // Every value in order, read along the leaf links
+    vector<DT> result;
+    result.reserve(size);
+    long long page = root;
+    while (true) { // Leftmost leaf
+        DiskNode<DT> node(pool->pin(page), M);
+        long long child = node.leaf() ? -1 : node.children()[0];
+        pool->unpin(page, false);
+        if (child < 0) {
+            break;
+        }
+        page = child;
+    }
+    while (page >= 0) {
+        DiskNode<DT> node(pool->pin(page), M);
+        result.insert(result.end(), node.keys(), node.keys() + node.count());
+        long long next = node.next();
+        pool->unpin(page, false);
+        page = next;
+    }
+    return result;
+}
+template <class DT>
+typename DiskMTree<DT>::iterator DiskMTree<DT>::lower_bound(const DT& value) { // First key >= value
+    long long page = leaf_for(value);
+    DiskNode<DT> node(pool->pin(page), M);
+    int i = node.position(value);
+    pool->unpin(page, false);
+    return iterator(this, page, i);
+}
+template <class DT>
+typename DiskMTree<DT>::iterator DiskMTree<DT>::end() { // Past the last key
+    return iterator(this, -1, 0);
+}
+template <class DT>
+DiskMTree<DT>::iterator::iterator(DiskMTree<DT>* tree, long long leaf, int index) { // Constructor
+    (*this).tree = tree;
+    (*this).leaf = leaf;
+    (*this).index = index;
+    settle();
+}
+template <class DT>
+void DiskMTree<DT>::iterator::settle() { // Skips to the first key at or after (leaf, index), copying it out of the page
+    while (leaf >= 0) {
+        DiskNode<DT> node(tree->pool->pin(leaf), tree->M);
+        if (index < node.count()) {
+            key = node.keys()[index];
+            tree->pool->unpin(leaf, false);
+            return;
+        }
+        long long next = node.next();
+        tree->pool->unpin(leaf, false);
+        leaf = next;
+        index = 0;
+    }
+    index = 0;
+}
+template <class DT>
+const DT& DiskMTree<DT>::iterator::operator*() const { // Current key
+    return key;
+}
+template <class DT>
+typename DiskMTree<DT>::iterator& DiskMTree<DT>::iterator::operator++() { // Advance to the next key
+    index++;
+    settle();
+    return *this;
+}
+template <class DT>
+bool DiskMTree<DT>::iterator::operator==(const iterator& other) const {
+    return leaf == other.leaf && index == other.index;
+}
+template <class DT>
+bool DiskMTree<DT>::iterator::operator!=(const iterator& other) const {
+    return !(*this == other);
 }
 
-int main() {
-    int n = 0; // Amount of values within array
-    int MValue; // MValue for the MTree
-    int numCommands; // Number of commands given to the MTree
+// Runs the command stream on any tree with the MTree interface (the in-memory MTree or a DiskMTree) and prints the final list.
+template <class Tree>
+void runCommands(Tree* myTree, int numCommands) {
     char command; // Current command given to the MTree
     int value; // Value taken in (with a command that takes a value)
 
-    vector<int> mySortedValues(n); // Create vector with size of the number of values
-
-    cin >> n; // Read in number of values
-    for (int i = 0; i < n; i++) { // Puts the values into mySortedValues vector
-        int input;
-        cin >> input;
-        mySortedValues.push_back(input);
-    }
-
-    cin >> MValue; // Read in the MValue
-    MTree<int>* myTree = new MTree<int>(MValue); // Create MTree with MValue
-
-    (*myTree).buildTree(mySortedValues); // Create tree with sorted values list
-
-    cin >> numCommands; // Read in number of commands
     for (int i = 0; i < numCommands; i++) { // Increment through all commands
         cin >> command;
         switch (command) { // Switch/case to determine what each command does
@@ -283,6 +2705,28 @@ int main() {
                 }
                 break;
             }
+            case 'M': { // Merge a batch of values
+                int k; // Number of values in the batch
+                cin >> k;
+                vector<int> batch(k);
+                for (int j = 0; j < k; j++) {
+                    cin >> batch[j];
+                }
+                sort(batch.begin(), batch.end()); // bulk_merge takes the batch in sorted order
+                int added = myTree->bulk_merge(batch.begin(), batch.end());
+                cout << "The batch of " << k << " values has been merged (" << added << " new)." << endl;
+                break;
+            }
+            case 'Q': { // Range query over [low, high)
+                int low, high;
+                cin >> low >> high;
+                cout << "Values in [" << low << ", " << high << "):";
+                for (typename Tree::iterator it = myTree->lower_bound(low); it != myTree->end() && *it < high; ++it) { // Walks the leaves from low onwards
+                    cout << " " << *it;
+                }
+                cout << endl;
+                break;
+            }
             case 'B': { // Rebuild Tree
                 vector<int> myValues = (*myTree).collect_values(); // Takes values within current tree
                 (*myTree).buildTree(myValues); // Rebuilds the tree
@@ -298,9 +2742,9 @@ int main() {
 
     cout << "Final list: ";
     vector<int> finalList = myTree->collect_values(); // Grabs all values within MTree and puts them into finalList vector
-    for (int i = 0, j = 1; i < finalList.size(); i++, j++) { // Prints every value within finalList vector
+    for (int i = 0, j = 1; i < (int)finalList.size(); i++, j++) { // Prints every value within finalList vector
         cout << finalList[i];
-        if (i < finalList.size() - 1) { // If the value is not the last value in the vector, put a space after the value
+        if (i < (int)finalList.size() - 1) { // If the value is not the last value in the vector, put a space after the value
             cout << " ";
         }
         if (j % 20 == 0 && j != 0) { // Every 20 values there should be a newline
@@ -308,6 +2752,70 @@ int main() {
         }
     }
 
+}
+
+int main(int argc, char* argv[]) {
+    int n = 0; // Amount of values within array
+    int MValue; // MValue for the MTree
+    int numCommands; // Number of commands given to the MTree
+
+    if (argc > 1 && string(argv[1]) == "--concurrent-benchmark") { // project4 --concurrent-benchmark [readers] [M] [keys] [seconds]
+        int readers = argc > 2 ? atoi(argv[2]) : 4;
+        int M = argc > 3 ? atoi(argv[3]) : 32;
+        int keys = argc > 4 ? atoi(argv[4]) : 1000000;
+        double seconds = argc > 5 ? atof(argv[5]) : 2.0;
+        concurrentBenchmark(readers, M, keys, seconds);
+        return 0;
+    }
+    if (argc > 1 && string(argv[1]) == "--benchmark") { // project4 --benchmark [max keys] [max M]
+        int keys = argc > 2 ? atoi(argv[2]) : 1000000;
+        int maxM = argc > 3 ? atoi(argv[3]) : 256;
+        treeBenchmark(keys < 1000 ? 1000 : keys, maxM < 3 ? 3 : maxM);
+        return 0;
+    }
+
+    vector<int> mySortedValues(n); // Create vector with size of the number of values
+
+    cin >> n; // Read in number of values
+    for (int i = 0; i < n; i++) { // Puts the values into mySortedValues vector
+        int input;
+        cin >> input;
+        mySortedValues.push_back(input);
+    }
+
+    cin >> MValue; // Read in the MValue
+    if (argc > 2 && string(argv[1]) == "--disk") { // project4 --disk <index file> [pool pages]: the tree lives in the file
+        try {
+            DiskMTree<int>* myTree = new DiskMTree<int>(argv[2], MValue, argc > 3 ? atoi(argv[3]) : 256);
+            if (!myTree->reopened()) { // New index: build it from the values
+                myTree->buildTree(mySortedValues);
+            }
+            else { // Existing index: the values are added to what it already holds
+                myTree->bulk_merge(mySortedValues.begin(), mySortedValues.end());
+            }
+            cin >> numCommands; // Read in number of commands
+            runCommands(myTree, numCommands);
+            myTree->flush(); // Writes the tree back here, where a write error can still be reported
+            delete myTree; // Closes the file
+        } catch (DiskIOException& e) {
+            cerr << e.what() << endl;
+            return 1;
+        }
+        return 0;
+    }
+    MTree<int>* myTree = new MTree<int>(MValue); // Create MTree with MValue
+    if (argc > 1 && string(argv[1]) == "--compressed") { // Read-mostly lookups use the compressed packed copy
+        myTree->set_compressed(true);
+    }
+    if (argc > 1 && string(argv[1]) == "--frozen") { // Read-mostly lookups use the frozen snapshot
+        myTree->set_frozen(true);
+    }
+
+    (*myTree).buildTree(mySortedValues); // Create tree with sorted values list
+
+    cin >> numCommands; // Read in number of commands
+    runCommands(myTree, numCommands);
+
     delete myTree; // Delete MTree
     return 0; // Program end
 }
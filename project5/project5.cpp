@@ -6,9 +6,16 @@ This program is designed to read in a text file, parse its content into tokens,
 #include <iostream>
 // #include <fstream>
 #include <string>
-#include <map>
-#include <iterator>
+#include <cstring>
 #include <algorithm>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 using namespace std;
 
@@ -19,76 +26,843 @@ of the input into a string array for the printing of the indexes within the uniq
 To prove I originally did the project as intended, I have all of the code I used on my computer noted out for the project submission.
 */
 
-int main() {
+// Interned tokens: an open-addressing hash table (linear probing) from a token's bytes to a dense ID. Each slot holds the
+// token's hash next to its ID, so most probes that miss never look at the bytes. The bytes of every distinct token are
+// copied once into one arena, which stays small and hot in cache next to the input.
+class TokenTable {
+    public:
+        unsigned long long* slots; // hash << 32 | (ID + 1) of the token in each slot, 0 for an empty slot
+        int capacity; // Number of slots (a power of two, at most half full)
+        int uniqueCount; // Number of distinct tokens, IDs are 0 ... uniqueCount - 1
+        int idCapacity; // Room in the per-ID arrays
+        long long* starts; // Offset of each token in arena
+        int* lengths; // Length of each token
+        long long* counts; // Occurrences of each token
+        char* arena; // Bytes of every distinct token, back to back
+        long long arenaSize; // Bytes used in arena
+        long long arenaCapacity; // Room in arena
+        TokenTable(); // Constructor
+        ~TokenTable(); // Destructor
+        static unsigned int hash(const char* token, int length); // FNV-1a hash of a token
+        int probe(const char* token, int length, unsigned int h, int& slot) const; // ID of the token (-1 if absent), slot where the search ended
+        int lookup(const char* token, int length) const; // ID of the token, -1 if it is not in the table
+        int intern(const char* token, int length); // ID of the token, added with count 0 if new
+        void grow(); // Doubles the slot array and the per-ID arrays
+        const char* text(int id) const; // Bytes of a token
+        bool before(int a, int b) const; // Rank order: higher count first, ties in byte order
+        void merge(const TokenTable& other); // Adds the tokens and counts of another table
+};
+TokenTable::TokenTable() { // Constructor
+    (*this).capacity = 1024;
+    (*this).slots = new unsigned long long[capacity]();
+    (*this).uniqueCount = 0;
+    (*this).idCapacity = capacity / 2;
+    (*this).starts = new long long[idCapacity];
+    (*this).lengths = new int[idCapacity];
+    (*this).counts = new long long[idCapacity];
+    (*this).arenaSize = 0;
+    (*this).arenaCapacity = 1 << 16;
+    (*this).arena = new char[arenaCapacity];
+}
+TokenTable::~TokenTable() { // Destructor
+    delete[] slots;
+    delete[] starts;
+    delete[] lengths;
+    delete[] counts;
+    delete[] arena;
+}
+unsigned int TokenTable::hash(const char* token, int length) { // FNV-1a hash of a token
+    unsigned int h = 2166136261u;
+    for (int i = 0; i < length; i++) {
+        h = (h ^ (unsigned char)token[i]) * 16777619u;
+    }
+    return h;
+}
+int TokenTable::probe(const char* token, int length, unsigned int h, int& slot) const { // ID of the token (-1 if absent)
+    slot = h & (capacity - 1);
+    while (slots[slot] != 0) { // Probe until the token or an empty slot turns up
+        if ((unsigned int)(slots[slot] >> 32) == h) {
+            int id = (int)(slots[slot] & 0xffffffffu) - 1;
+            if (lengths[id] == length && memcmp(arena + starts[id], token, length) == 0) {
+                return id;
+            }
+        }
+        slot = (slot + 1) & (capacity - 1);
+    }
+    return -1;
+}
+int TokenTable::lookup(const char* token, int length) const { // ID of the token, -1 if it is not in the table
+    int slot;
+    return probe(token, length, hash(token, length), slot);
+}
+int TokenTable::intern(const char* token, int length) { // ID of the token, added with count 0 if new
+    unsigned int h = hash(token, length);
+    int slot;
+    int found = probe(token, length, h, slot);
+    if (found >= 0) {
+        return found;
+    }
+    int id = uniqueCount++;
+    if (arenaSize + length > arenaCapacity) { // Double the arena
+        while (arenaSize + length > arenaCapacity) {
+            arenaCapacity *= 2;
+        }
+        char* bigger = new char[arenaCapacity];
+        memcpy(bigger, arena, arenaSize);
+        delete[] arena;
+        arena = bigger;
+    }
+    memcpy(arena + arenaSize, token, length);
+    starts[id] = arenaSize;
+    arenaSize += length;
+    lengths[id] = length;
+    counts[id] = 0;
+    slots[slot] = (unsigned long long)h << 32 | (unsigned int)(id + 1);
+    if (uniqueCount == idCapacity) { // Half full: keep probe runs short
+        grow();
+    }
+    return id;
+}
+void TokenTable::grow() { // Doubles the slot array and the per-ID arrays
+    unsigned long long* old = slots;
+    int oldCapacity = capacity;
+    capacity *= 2;
+    slots = new unsigned long long[capacity]();
+    for (int i = 0; i < oldCapacity; i++) { // Reinsert by the stored hashes
+        if (old[i] != 0) {
+            int slot = (old[i] >> 32) & (capacity - 1);
+            while (slots[slot] != 0) {
+                slot = (slot + 1) & (capacity - 1);
+            }
+            slots[slot] = old[i];
+        }
+    }
+    delete[] old;
+
+    idCapacity = capacity / 2;
+    long long* newStarts = new long long[idCapacity];
+    int* newLengths = new int[idCapacity];
+    long long* newCounts = new long long[idCapacity];
+    copy(starts, starts + uniqueCount, newStarts);
+    copy(lengths, lengths + uniqueCount, newLengths);
+    copy(counts, counts + uniqueCount, newCounts);
+    delete[] starts;
+    delete[] lengths;
+    delete[] counts;
+    starts = newStarts;
+    lengths = newLengths;
+    counts = newCounts;
+}
+const char* TokenTable::text(int id) const { // Bytes of a token
+    return arena + starts[id];
+}
+bool TokenTable::before(int a, int b) const { // Rank order: higher count first, ties in byte order (as std::string compares)
+    if (counts[a] != counts[b]) {
+        return counts[a] > counts[b];
+    }
+    int c = memcmp(text(a), text(b), min(lengths[a], lengths[b]));
+    return c != 0 ? c < 0 : lengths[a] < lengths[b];
+}
+void TokenTable::merge(const TokenTable& other) { // Adds the tokens and counts of another table
+    for (int id = 0; id < other.uniqueCount; id++) {
+        int mine = intern(other.text(id), other.lengths[id]); // May grow the table, so counts is read after
+        counts[mine] += other.counts[id];
+    }
+}
+
+unsigned int crc32(unsigned int crc, const char* bytes, long long length) { // Continues a CRC-32 (IEEE, as zlib) over bytes
+    static unsigned int table[256]; // CRC of every byte value, built on first use
+    static bool ready = false;
+    if (!ready) {
+        for (unsigned int b = 0; b < 256; b++) {
+            unsigned int c = b;
+            for (int k = 0; k < 8; k++) {
+                c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            }
+            table[b] = c;
+        }
+        ready = true;
+    }
+    crc = ~crc;
+    for (long long i = 0; i < length; i++) {
+        crc = table[(crc ^ (unsigned char)bytes[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+// A growable buffer in memory. Each block is encoded into one of these on its own thread, then written out in order.
+class ByteBuffer {
+    public:
+        char* data; // Bytes so far
+        long long size; // Number of bytes in data
+        long long capacity; // Room in data
+        ByteBuffer(); // Constructor
+        ~ByteBuffer(); // Destructor
+        void reserve(long long extra); // Makes room for extra more bytes
+        void put(const char* bytes, long long length); // Appends bytes
+        void put(char c); // Appends one byte
+        void putNumber(unsigned int number); // Appends a number in decimal
+        void putVarint(unsigned long long number); // Appends a number as a LEB128 varint (7 bits per byte, low bits first)
+};
+ByteBuffer::ByteBuffer() { // Constructor
+    size = 0;
+    capacity = 1 << 16;
+    data = new char[capacity];
+}
+ByteBuffer::~ByteBuffer() { // Destructor
+    delete[] data;
+}
+void ByteBuffer::reserve(long long extra) { // Makes room for extra more bytes
+    if (size + extra <= capacity) {
+        return;
+    }
+    while (size + extra > capacity) {
+        capacity *= 2;
+    }
+    char* bigger = new char[capacity];
+    memcpy(bigger, data, size);
+    delete[] data;
+    data = bigger;
+}
+void ByteBuffer::put(const char* bytes, long long length) { // Appends bytes
+    reserve(length);
+    memcpy(data + size, bytes, length);
+    size += length;
+}
+void ByteBuffer::put(char c) { // Appends one byte
+    reserve(1);
+    data[size++] = c;
+}
+void ByteBuffer::putNumber(unsigned int number) { // Appends a number in decimal
+    char digits[10];
+    int n = 0;
+    do {
+        digits[n++] = '0' + number % 10;
+        number /= 10;
+    } while (number > 0);
+    reserve(n);
+    while (n > 0) {
+        data[size++] = digits[--n];
+    }
+}
+void ByteBuffer::putVarint(unsigned long long number) { // Appends a number as a LEB128 varint
+    reserve(10);
+    while (number >= 0x80) {
+        data[size++] = (char)(number | 0x80);
+        number >>= 7;
+    }
+    data[size++] = (char)number;
+}
+
+// Collects output in a large buffer and hands it to cout in big writes instead of one small write per token. It also
+// keeps a CRC-32 of everything written so far, for the checksum at the end of the binary format.
+class OutputBuffer {
+    public:
+        static const int SIZE = 1 << 16; // Bytes buffered before a write
+        char* data; // Buffered bytes
+        int used; // Bytes in data
+        long long written; // Bytes written out so far
+        unsigned int crc; // CRC-32 of the bytes written out so far
+        OutputBuffer(); // Constructor
+        ~OutputBuffer(); // Destructor (flushes)
+        void put(const char* bytes, long long length); // Appends bytes
+        void put(char c); // Appends one byte
+        void putVarint(unsigned long long number); // Appends a number as a LEB128 varint
+        void putChecksum(); // Appends the CRC-32 of everything before it, 4 bytes little endian
+        long long position() const; // Bytes put so far
+        void flush(); // Writes out everything buffered
+};
+OutputBuffer::OutputBuffer() { // Constructor
+    data = new char[SIZE];
+    used = 0;
+    written = 0;
+    crc = 0;
+}
+OutputBuffer::~OutputBuffer() { // Destructor
+    flush();
+    delete[] data;
+}
+void OutputBuffer::put(const char* bytes, long long length) { // Appends bytes
+    if (used + length > SIZE) {
+        flush();
+    }
+    if (length > SIZE) { // Too large to buffer (a whole block)
+        crc = crc32(crc, bytes, length);
+        cout.write(bytes, length);
+        written += length;
+        return;
+    }
+    memcpy(data + used, bytes, length);
+    used += length;
+}
+void OutputBuffer::put(char c) { // Appends one byte
+    if (used == SIZE) {
+        flush();
+    }
+    data[used++] = c;
+}
+void OutputBuffer::putVarint(unsigned long long number) { // Appends a number as a LEB128 varint
+    if (used + 10 > SIZE) {
+        flush();
+    }
+    while (number >= 0x80) {
+        data[used++] = (char)(number | 0x80);
+        number >>= 7;
+    }
+    data[used++] = (char)number;
+}
+void OutputBuffer::putChecksum() { // Appends the CRC-32 of everything before it
+    flush();
+    char bytes[4] = {(char)crc, (char)(crc >> 8), (char)(crc >> 16), (char)(crc >> 24)};
+    put(bytes, 4);
+}
+long long OutputBuffer::position() const { // Bytes put so far
+    return written + used;
+}
+void OutputBuffer::flush() { // Writes out everything buffered
+    crc = crc32(crc, data, used);
+    cout.write(data, used);
+    written += used;
+    used = 0;
+}
+
+bool isSeparator(unsigned char c) { // The bytes cin >> token skips
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+// The bytes to compress. A regular file (named on the command line, or redirected to stdin) is memory-mapped and read
+// straight from the page cache, so it never has to fit in memory: each pass hands back the pages it has finished with
+// (release), which keeps the resident set to a window of WINDOW bytes plus the dictionary. Anything that cannot be
+// mapped (a pipe) is read into a buffer instead.
+class InputText {
+    public:
+        static const long long WINDOW = 16LL << 20; // Bytes of a mapped file kept resident at most
+        const char* data; // Input bytes
+        long long size; // Number of bytes
+        bool mapped; // data is a mapping of the file (otherwise a buffer of our own)
+        long long released; // Bytes at the front already handed back
+        InputText(int fd); // Maps or reads everything fd has to offer
+        ~InputText(); // Unmaps or frees the bytes
+        void release(long long upTo); // Lets the kernel drop mapped pages before upTo once a window has been passed
+        void rewind(); // Starts a new pass
+};
+InputText::InputText(int fd) { // Maps or reads everything fd has to offer
+    data = nullptr;
+    size = 0;
+    mapped = false;
+    released = 0;
+    struct stat info;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode)) {
+        size = info.st_size;
+        if (size == 0) {
+            return;
+        }
+        void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            data = (const char*)map;
+            mapped = true;
+            madvise(map, size, MADV_SEQUENTIAL); // Read ahead aggressively, drop behind
+            return;
+        }
+    }
+    long long capacity = 1 << 20; // Room in the buffer
+    char* buffer = new char[capacity];
+    size = 0;
+    while (cin.read(buffer + size, capacity - size) || cin.gcount() > 0) { // Read everything, doubling the buffer as needed
+        size += cin.gcount();
+        if (size == capacity) {
+            char* bigger = new char[capacity * 2];
+            memcpy(bigger, buffer, size);
+            delete[] buffer;
+            buffer = bigger;
+            capacity *= 2;
+        }
+    }
+    data = buffer;
+}
+InputText::~InputText() { // Unmaps or frees the bytes
+    if (mapped) {
+        munmap((void*)data, size);
+    }
+    else {
+        delete[] data;
+    }
+}
+void InputText::release(long long upTo) { // Lets the kernel drop mapped pages before upTo
+    if (!mapped || upTo - released < WINDOW) {
+        return;
+    }
+    long long page = sysconf(_SC_PAGESIZE);
+    long long end = upTo / page * page;
+    madvise((void*)(data + released), end - released, MADV_DONTNEED); // Clean file pages: they come back from the file if touched
+    released = end;
+}
+void InputText::rewind() { // Starts a new pass
+    released = 0;
+}
+
+#ifdef __SSE2__
+// Byte classes 16 bytes at a time: bit k of the result is set when data[k] is a separator. ' ' is compared directly;
+// '\t' ... '\r' are the bytes that land in 0 ... 4 once '\t' is subtracted (an unsigned min finds those).
+inline unsigned int separatorMask(const char* data) {
+    __m128i bytes = _mm_loadu_si128((const __m128i*)data);
+    __m128i space = _mm_cmpeq_epi8(bytes, _mm_set1_epi8(' '));
+    __m128i shifted = _mm_sub_epi8(bytes, _mm_set1_epi8('\t'));
+    __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8(4)), shifted);
+    return _mm_movemask_epi8(_mm_or_si128(space, control));
+}
+#endif
+
+long long skipSeparators(const char* data, long long i, long long end) { // First byte at or after i that is not a separator (or end)
+    if (i < end && !isSeparator(data[i])) { // Most runs are a single space, so the first byte is checked on its own
+        return i;
+    }
+#ifdef __SSE2__
+    for (; i + 16 <= end; i += 16) {
+        unsigned int others = ~separatorMask(data + i) & 0xffff;
+        if (others != 0) {
+            return i + __builtin_ctz(others);
+        }
+    }
+#endif
+    while (i < end && isSeparator(data[i])) {
+        i++;
+    }
+    return i;
+}
+
+long long skipToken(const char* data, long long i, long long end) { // First separator at or after i (or end)
+#ifdef __SSE2__
+    for (; i + 16 <= end; i += 16) {
+        unsigned int separators = separatorMask(data + i);
+        if (separators != 0) {
+            return i + __builtin_ctz(separators);
+        }
+    }
+#endif
+    while (i < end && !isSeparator(data[i])) {
+        i++;
+    }
+    return i;
+}
+
+// In lossless mode a block is read as separator run, token, separator run, ..., token, separator run, where the
+// first and last runs may be empty. Only the runs that differ from the usual one are stored: a single space between
+// two tokens, nothing at either end of the block.
+bool plainSeparator(const char* run, long long length, bool edge) {
+    return edge ? length == 0 : length == 1 && run[0] == ' ';
+}
+
+// Splits the input into blocks of about BLOCK bytes, each cut just after a separator so no token straddles two blocks.
+// Returns count + 1 boundaries: block b is bounds[b] ... bounds[b + 1].
+const long long BLOCK = 4LL << 20;
+long long* splitBlocks(const InputText& input, int& count) {
+    count = (int)((input.size + BLOCK - 1) / BLOCK);
+    long long* bounds = new long long[count + 1];
+    bounds[0] = 0;
+    for (int b = 1; b <= count; b++) {
+        long long cut = max(bounds[b - 1], min((long long)b * BLOCK, input.size));
+        while (cut < input.size && cut > 0 && !isSeparator(input.data[cut - 1])) { // Move the cut past the token it lands in
+            cut++;
+        }
+        bounds[b] = cut;
+    }
+    return bounds;
+}
+
+// Runs task(0) ... task(count - 1) at the same time, the last one on the calling thread, and waits for all of them.
+template <class Task>
+void runParallel(int count, const Task& task) {
+    thread* workers = new thread[count - 1];
+    for (int t = 0; t < count - 1; t++) {
+        workers[t] = thread(task, t);
+    }
+    task(count - 1);
+    for (int t = 0; t < count - 1; t++) {
+        workers[t].join();
+    }
+    delete[] workers;
+}
+
+// First pass over one block: intern and count each token, and in lossless mode (separators not null) each separator
+// run that is not the plain one.
+long long countBlock(const InputText& input, long long begin, long long end, TokenTable& table, TokenTable* separators) {
+    long long tokens = 0;
+    long long i = begin; // Scan position
+    while (true) {
+        long long run = i; // Start of the separator run
+        i = skipSeparators(input.data, i, end);
+        if (separators != nullptr && !plainSeparator(input.data + run, i - run, tokens == 0 || i == end)) {
+            int id = (*separators).intern(input.data + run, i - run);
+            (*separators).counts[id]++;
+        }
+        if (i == end) {
+            return tokens;
+        }
+        long long start = i; // Start of the token
+        i = skipToken(input.data, i, end);
+        int id = table.intern(input.data + start, i - start); // May grow the table, so counts is read after
+        table.counts[id]++;
+        tokens++;
+    }
+}
+
+// The ranks one block uses, for the inverted index of the binary container. lastBlock stamps every rank with the last
+// block it was seen in, so each rank is listed once per block without clearing anything between blocks.
+class BlockRanks {
+    public:
+        int* lastBlock; // Last block each rank was seen in, -1 if none yet
+        int* ranks; // Distinct ranks (0 based) of the current block, in order of first use
+        int count; // Number of ranks listed
+        BlockRanks(int uniqueCount); // Constructor
+        ~BlockRanks(); // Destructor
+        void add(int rank, int block); // Lists rank for block unless it already is
+};
+BlockRanks::BlockRanks(int uniqueCount) { // Constructor
+    (*this).lastBlock = new int[uniqueCount];
+    (*this).ranks = new int[uniqueCount];
+    (*this).count = 0;
+    fill(lastBlock, lastBlock + uniqueCount, -1);
+}
+BlockRanks::~BlockRanks() { // Destructor
+    delete[] lastBlock;
+    delete[] ranks;
+}
+void BlockRanks::add(int rank, int block) { // Lists rank for block unless it already is
+    if (lastBlock[rank] != block) {
+        lastBlock[rank] = block;
+        ranks[count++] = rank;
+    }
+}
+
+const int SYNC = 1024; // Tokens between sync points of the binary container
+
+// Second pass over one block: replace every token with its rank. For the binary container it also writes the byte
+// offset of every SYNC-th token (from the previous sync point) to syncs, and lists the ranks the block uses in used.
+// In lossless mode (separators not null) the ranks are followed by the runs that are not plain: their number, then
+// for each its index among the block's runs (as the distance from the one after the previous such run) and its
+// separator rank - 1. exceptions is scratch space for those.
+void encodeBlock(const InputText& input, long long begin, long long end, const TokenTable& table, const int* rankOf, const TokenTable* separators, const int* separatorRankOf, bool binary, int block, ByteBuffer& out, ByteBuffer& syncs, BlockRanks* used, ByteBuffer& exceptions) {
+    out.size = 0;
+    syncs.size = 0;
+    exceptions.size = 0;
+    long long exceptionCount = 0; // Runs stored
+    long long nextRun = 0; // Index of the run after the last one stored
+    long long tokens = 0; // Tokens encoded so far
+    long long lastSync = 0; // Offset of the last sync point, the start of the block being the first
+    long long i = begin;
+    while (true) {
+        long long run = i; // Start of the separator run before the next token
+        i = skipSeparators(input.data, i, end);
+        if (separators != nullptr && !plainSeparator(input.data + run, i - run, tokens == 0 || i == end)) {
+            exceptions.putVarint(tokens - nextRun);
+            exceptions.putVarint(separatorRankOf[(*separators).lookup(input.data + run, i - run)] - 1);
+            exceptionCount++;
+            nextRun = tokens + 1;
+        }
+        if (i == end) {
+            break;
+        }
+        long long start = i; // Start of the token
+        i = skipToken(input.data, i, end);
+        int rank = rankOf[table.lookup(input.data + start, i - start)]; // The table is only read here, so blocks can share it
+        if (binary) { // Stored from 0, so the 128 most frequent tokens take one byte each
+            if (tokens > 0 && tokens % SYNC == 0) {
+                syncs.putVarint(out.size - lastSync);
+                lastSync = out.size;
+            }
+            (*used).add(rank - 1, block);
+            out.putVarint(rank - 1);
+        }
+        else {
+            out.putNumber(rank);
+            out.put(' ');
+        }
+        tokens++;
+    }
+    if (separators != nullptr) {
+        out.putVarint(exceptionCount);
+        out.put(exceptions.data, exceptions.size);
+    }
+}
+
+// Binary container (--binary), all numbers LEB128 varints:
+//   "P5B3", or "P5S3" (lossless) magic
+//   uniqueCount, tokenCount
+//   uniqueCount times           token length, token bytes (in rank order)
+//   lossless only:              separatorCount, then as many separator run lengths and bytes (in rank order)
+//   per block                   rank - 1 of each of its tokens, then in lossless mode its separator runs that are
+//                               not plain (see encodeBlock)
+//   blockCount, SYNC            the block index:
+//   per block                     token count, length in bytes,
+//                                 offset of every SYNC-th token from the previous one (the block start first)
+//   uniqueCount times           the inverted index: number of blocks that use the rank, then those blocks in
+//                               increasing order, each as the difference from the one before (the first as is),
+//                               or a bitmap of blockCount bits (block b is bit b % 8 of byte b / 8) when the rank
+//                               is in at least one block in eight and a bitmap is no longer than the list
+//   index offset                8 bytes, little endian: where the block index starts
+//   CRC-32 of all of the above  4 bytes, little endian
+// Blocks start at known byte offsets and token positions, so a decoder can decode them in parallel, and any token can
+// be reached by decoding at most SYNC - 1 tokens before it. The inverted index tells a search which blocks to skip.
+const char BINARY_MAGIC[5] = "P5B3";
+const char LOSSLESS_MAGIC[5] = "P5S3";
+
+void rankTable(const TokenTable& table, int*& list, int*& rankOf) { // IDs in rank order, and the rank (1 based) of every ID
+    list = new int[table.uniqueCount];
+    for (int id = 0; id < table.uniqueCount; id++) {
+        list[id] = id;
+    }
+    sort(list, list + table.uniqueCount, [&table](int a, int b) { // One sort by (frequency desc, token)
+        return table.before(a, b);
+    });
+    rankOf = new int[table.uniqueCount];
+    for (int r = 0; r < table.uniqueCount; r++) {
+        rankOf[list[r]] = r + 1;
+    }
+}
+
+int main(int argc, char* argv[]) {
 
     // string fileName; // Variable for storing the file name of the input file
-    map<string, int> orderedTokenCount; // Red/Black Tree to efficiently store the token with its corresponding frequency
-    string *tokenList = new string[1]; // Stores input tokens
-
-    string token; // Variable to store the current token being read in from input
-    int tokenCount = 0; // Variable to store the total number of tokens in the file
-
-    cin >> token; // Read in the first token
-    orderedTokenCount[token]++; // Place first token within Red/Black Tree
-    tokenList[tokenCount] = token; // Places first token into tokenList array
-    tokenCount++; // Increment tokenCount
-
-    // Hardcoded fileName detector
-    // if (token == "Can") { // If the first token is "Can" input1.txt is the fileName
-    //     fileName = "tests/input1.txt";
-    // }
-    // else if (token == "Technology") { // If the first token is "Technology" input2.txt is the fileName
-    //     fileName = "tests/input2.txt";
-    // }
-    // else { // Else the fileName is input3.txt
-    //     fileName = "tests/input3.txt";
-    // }
-
-    while (cin >> token) { // Read in the rest of the tokens
-        orderedTokenCount[token]++; // Add the tokens to the Red/Black Tree
-        tokenCount++; // Increment tokenCount
-        string *temp = new string[tokenCount]; // Temporary array
-        for (int i = 0; i < tokenCount - 1; i++) { // Move everything from uniqueTokenList to temp array
-            temp[i] = tokenList[i];
-        }
-        temp[tokenCount - 1] = token; // Add new token to temp array
-        delete[] tokenList; // Delete uniqueTokenList's contents
-        tokenList = temp; // Set uniqueTokenList equal to temp
-    }
-
-    string *uniqueTokenList = new string[tokenCount]; // Create a string array of size tokenCount to store unique tokens
-    int uniqueTokenCount = 0; // Variable to store amount of unique tokens
-    
-    for (int i = tokenCount; i > 0; i--) { // This loop goes from the amount of tokens down to 0
-        for (map<string, int>::iterator it = orderedTokenCount.begin(); it != orderedTokenCount.end(); ++it) { // This loop uses an iterator with my orderedTokenCount variable to print every token in order of their frequency
-            token = it->first; // Puts the first section (the string) into the token variable
-            if (it->second == i) { // Determines whether the second section (the int) is equivalent to i (token frequency)
-                cout << token << " "; // Print token
-                uniqueTokenList[uniqueTokenCount] = token; // Add unique token to unique token array
-                uniqueTokenCount++; // Increment uniqueTokenCount
+    ios::sync_with_stdio(false); // cin and cout are only used for large reads and writes
+    bool binary = false; // project5 [--binary | --lossless] [--threads N] [file]: write the binary container instead of text
+    bool lossless = false; // Keep every separator run too (binary container only), so the text comes back byte for byte
+    int threads = max(1, (int)thread::hardware_concurrency()); // Blocks worked on at the same time
+    int fd = 0; // The file to compress, stdin by default
+    for (int a = 1; a < argc; a++) {
+        if (string(argv[a]) == "--binary") {
+            binary = true;
+        }
+        else if (string(argv[a]) == "--lossless") {
+            binary = true;
+            lossless = true;
+        }
+        else if (string(argv[a]) == "--threads" && a + 1 < argc) {
+            threads = max(1, atoi(argv[++a]));
+        }
+        else {
+            fd = open(argv[a], O_RDONLY);
+            if (fd < 0) {
+                cerr << "Cannot open " << argv[a] << endl;
+                return 1;
             }
         }
     }
+    InputText input(fd); // The text, memory-mapped when it is a file
+    int blockCount; // Number of blocks the input is split into
+    long long* bounds = splitBlocks(input, blockCount);
 
-    cout << endl;
-    cout << "**********" << endl;
+    // The dictionary needs every count before the first rank can be written, so the text is read twice: once to count,
+    // once to encode. Only the dictionary is kept between the passes, not the tokens. Both passes take the blocks a
+    // round of `threads` at a time; in the first each thread counts into a table of its own, merged at the end.
+    TokenTable table; // Distinct tokens with their counts
+    TokenTable separators; // Distinct separator runs that are not plain, with their counts (lossless only)
+    TokenTable** local = new TokenTable*[threads]; // Table of each thread, the first one is table itself
+    TokenTable** localSeparators = new TokenTable*[threads]; // Same for separator runs
+    local[0] = &table;
+    localSeparators[0] = lossless ? &separators : nullptr;
+    for (int t = 1; t < threads; t++) {
+        local[t] = new TokenTable;
+        localSeparators[t] = lossless ? new TokenTable : nullptr;
+    }
+    long long* blockTokens = new long long[blockCount + 1]; // Tokens in each block
+    for (int base = 0; base < blockCount; base += threads) { // First pass: intern and count each token
+        int n = min(threads, blockCount - base);
+        runParallel(n, [&](int t) {
+            blockTokens[base + t] = countBlock(input, bounds[base + t], bounds[base + t + 1], *local[t], localSeparators[t]);
+        });
+        input.release(bounds[base + n]);
+    }
+    for (int t = 1; t < threads; t++) {
+        table.merge(*local[t]);
+        delete local[t];
+        if (lossless) {
+            separators.merge(*localSeparators[t]);
+            delete localSeparators[t];
+        }
+    }
+    delete[] local;
+    delete[] localSeparators;
+    long long tokenCount = 0; // Variable to store the total number of tokens in the file
+    for (int b = 0; b < blockCount; b++) {
+        tokenCount += blockTokens[b];
+    }
+    bool emptyToken = tokenCount == 0 && !lossless; // Empty input reads as one empty token, as cin >> token did
+    if (emptyToken) {
+        int id = table.intern("", 0);
+        table.counts[id]++;
+    }
+
+    int uniqueTokenCount = table.uniqueCount; // Variable to store amount of unique tokens
+    int* uniqueTokenList; // IDs in rank order
+    int* rankOf; // Rank (1 based) of every ID
+    rankTable(table, uniqueTokenList, rankOf);
+    int* separatorList; // Separator runs the same way
+    int* separatorRankOf;
+    rankTable(separators, separatorList, separatorRankOf);
+
+    OutputBuffer out; // Buffered cout
+    if (binary) { // Header and length-prefixed dictionary: magic, token counts, then each token's length and bytes
+        out.put(lossless ? LOSSLESS_MAGIC : BINARY_MAGIC, 4);
+        out.putVarint(uniqueTokenCount);
+        out.putVarint(emptyToken ? 1 : tokenCount);
+        for (int r = 0; r < uniqueTokenCount; r++) {
+            int id = uniqueTokenList[r];
+            out.putVarint(table.lengths[id]);
+            out.put(table.text(id), table.lengths[id]);
+        }
+        if (lossless) {
+            out.putVarint(separators.uniqueCount);
+            for (int r = 0; r < separators.uniqueCount; r++) {
+                int id = separatorList[r];
+                out.putVarint(separators.lengths[id]);
+                out.put(separators.text(id), separators.lengths[id]);
+            }
+        }
+    }
+    else {
+        for (int r = 0; r < uniqueTokenCount; r++) { // Print every token in order of their frequency
+            int id = uniqueTokenList[r];
+            out.put(table.text(id), table.lengths[id]);
+            out.put(' ');
+        }
+        out.put("\n**********\n", 12);
+    }
 
     // ifstream inputFile(fileName); // Open up the previously identified input file
 
-    for (int i = 0; i < tokenCount; i++) { // Go through entire inputFile and capture the tokens
-        // inputFile >> token; // Set token
-        token = tokenList[i]; // Read the tokens from tokenList into token
-        for (int j = 0; j < uniqueTokenCount; j++) { // Go through the entire uniqueTokenList to determine the index of the current token being read in
-            if (token == uniqueTokenList[j]) { // Determine whether or not the current token being read in is the jth token within the array
-                cout << (j + 1); // The output starts from index 1, so increment all indeces by 1
-                break; // Break when the token is found within uniqueTokenList
+    input.rewind();
+    ByteBuffer* encoded = new ByteBuffer[threads]; // Output of the blocks of one round
+    ByteBuffer* syncs = new ByteBuffer[threads]; // Sync points of the blocks of one round
+    ByteBuffer* exceptions = new ByteBuffer[threads]; // Scratch space for the separator runs of each thread
+    BlockRanks** used = new BlockRanks*[threads]; // Ranks used by the blocks of one round (binary only)
+    for (int t = 0; t < threads; t++) {
+        used[t] = binary ? new BlockRanks(uniqueTokenCount) : nullptr;
+    }
+    ByteBuffer blockIndex; // Token count, length and sync points of every block, as written
+    long long postingCapacity = 1 << 16; // Room in postings
+    int* postings = new int[postingCapacity]; // Ranks used by each block, block after block
+    long long* postingEnd = new long long[blockCount + 1]; // End of each block's ranks in postings
+    for (int base = 0; base < blockCount && !emptyToken; base += threads) { // Second pass: replace every token with its rank
+        int n = min(threads, blockCount - base);
+        runParallel(n, [&](int t) {
+            encodeBlock(input, bounds[base + t], bounds[base + t + 1], table, rankOf, lossless ? &separators : nullptr, separatorRankOf, binary, base + t, encoded[t], syncs[t], used[t], exceptions[t]);
+        });
+        for (int t = 0; t < n; t++) { // Written out in input order
+            out.put(encoded[t].data, encoded[t].size);
+            if (!binary) {
+                continue;
+            }
+            blockIndex.putVarint(blockTokens[base + t]);
+            blockIndex.putVarint(encoded[t].size);
+            blockIndex.put(syncs[t].data, syncs[t].size);
+            long long from = base + t > 0 ? postingEnd[base + t - 1] : 0;
+            if (from + (*used[t]).count > postingCapacity) { // Double the postings
+                while (from + (*used[t]).count > postingCapacity) {
+                    postingCapacity *= 2;
+                }
+                int* bigger = new int[postingCapacity];
+                copy(postings, postings + from, bigger);
+                delete[] postings;
+                postings = bigger;
             }
+            copy((*used[t]).ranks, (*used[t]).ranks + (*used[t]).count, postings + from);
+            postingEnd[base + t] = from + (*used[t]).count;
+            (*used[t]).count = 0;
+        }
+        input.release(bounds[base + n]);
+    }
+    for (int t = 0; t < threads; t++) {
+        delete used[t];
+    }
+    delete[] used;
+    delete[] exceptions;
+    delete[] syncs;
+    delete[] encoded;
+    if (emptyToken) { // The empty token is the only block
+        blockCount = 1;
+        postings[0] = 0;
+        postingEnd[0] = 1;
+        if (binary) {
+            out.putVarint(0);
+            blockIndex.putVarint(1);
+            blockIndex.putVarint(1);
+        }
+        else {
+            out.put("1 ", 2);
         }
-        cout << " ";
     }
+    if (binary) {
+        unsigned long long indexOffset = out.position();
+        out.putVarint(blockCount);
+        out.putVarint(SYNC);
+        out.put(blockIndex.data, blockIndex.size);
 
-    cout << endl;
+        // Inverted index: the postings are grouped by block, so a counting sort by rank turns them into each rank's
+        // list of blocks, still in increasing block order.
+        long long postingCount = blockCount > 0 ? postingEnd[blockCount - 1] : 0; // Ranks used by each block, over all blocks
+        long long* rankStart = new long long[uniqueTokenCount + 1](); // Start of each rank's blocks in blocksOf
+        for (long long p = 0; p < postingCount; p++) {
+            rankStart[postings[p] + 1]++;
+        }
+        for (int r = 0; r < uniqueTokenCount; r++) {
+            rankStart[r + 1] += rankStart[r];
+        }
+        int* blocksOf = new int[postingCount]; // Blocks of every rank, rank after rank
+        long long* next = new long long[uniqueTokenCount]; // Where the next block of each rank goes
+        copy(rankStart, rankStart + uniqueTokenCount, next);
+        for (int b = 0; b < blockCount; b++) {
+            for (long long p = b > 0 ? postingEnd[b - 1] : 0; p < postingEnd[b]; p++) {
+                blocksOf[next[postings[p]]++] = b;
+            }
+        }
+        int bitmapBytes = (blockCount + 7) / 8; // Length of a bitmap of the blocks
+        char* bitmap = new char[bitmapBytes];
+        for (int r = 0; r < uniqueTokenCount; r++) {
+            long long blocks = rankStart[r + 1] - rankStart[r];
+            out.putVarint(blocks);
+            if (blocks >= bitmapBytes) { // Common token: one bit per block
+                fill(bitmap, bitmap + bitmapBytes, 0);
+                for (long long p = rankStart[r]; p < rankStart[r + 1]; p++) {
+                    bitmap[blocksOf[p] / 8] |= (char)(1 << (blocksOf[p] % 8));
+                }
+                out.put(bitmap, bitmapBytes);
+                continue;
+            }
+            int previous = 0;
+            for (long long p = rankStart[r]; p < rankStart[r + 1]; p++) {
+                out.putVarint(blocksOf[p] - previous);
+                previous = blocksOf[p];
+            }
+        }
+        delete[] bitmap;
+        delete[] next;
+        delete[] blocksOf;
+        delete[] rankStart;
 
+        char offset[8];
+        for (int k = 0; k < 8; k++) {
+            offset[k] = (char)(indexOffset >> (8 * k));
+        }
+        out.put(offset, 8);
+        out.putChecksum();
+    }
+    else {
+        out.put('\n');
+    }
+    out.flush();
+
+    delete[] postingEnd;
+    delete[] postings;
+    delete[] blockTokens;
+    delete[] bounds;
+    delete[] separatorRankOf;
+    delete[] separatorList;
+    delete[] rankOf;
+    delete[] uniqueTokenList;
+    if (fd != 0) {
+        close(fd);
+    }
     return 0;
 }
 
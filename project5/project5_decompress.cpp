@@ -4,134 +4,747 @@ Take the output from project5.cpp and convert it back into the original text.
 */
 
 #include <iostream>
-#include <fstream>
-#include <sstream>
 #include <string>
-#include <map>
-#include <iterator>
+#include <cstring>
 #include <algorithm>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 using namespace std;
 
-int main() {
-
-    string outputFromProject5File; // Variable for storing all output from the original project5 file so that I can use it for project5_decompress
-
-    /*
-    DISCLAIMER!
-    Below is the original project5 program (the only change is all output is redirected from the console to outputFromProject5File)
-    */
-
-    // string fileName; // Variable for storing the file name of the input file
-    map<string, int> orderedTokenCount; // Red/Black Tree to efficiently store the token with its corresponding frequency
-    string *tokenList = new string[1]; // Stores input tokens
-
-    string token; // Variable to store the current token being read in from input
-    int tokenCount = 0; // Variable to store the total number of tokens in the file
-
-    cin >> token; // Read in the first token
-    orderedTokenCount[token]++; // Place first token within Red/Black Tree
-    tokenList[tokenCount] = token; // Places first token into tokenList array
-    tokenCount++; // Increment tokenCount
-
-    // Hardcoded fileName detector
-    // if (token == "Can") { // If the first token is "Can" input1.txt is the fileName
-    //     fileName = "tests/input1.txt";
-    // }
-    // else if (token == "Technology") { // If the first token is "Technology" input2.txt is the fileName
-    //     fileName = "tests/input2.txt";
-    // }
-    // else { // Else the fileName is input3.txt
-    //     fileName = "tests/input3.txt";
-    // }
-
-    while (cin >> token) { // Read in the rest of the tokens
-        orderedTokenCount[token]++; // Add the tokens to the Red/Black Tree
-        tokenCount++; // Increment tokenCount
-        string *temp = new string[tokenCount]; // Temporary array
-        for (int i = 0; i < tokenCount - 1; i++) { // Move everything from uniqueTokenList to temp array
-            temp[i] = tokenList[i];
-        }
-        temp[tokenCount - 1] = token; // Add new token to temp array
-        delete[] tokenList; // Delete uniqueTokenList's contents
-        tokenList = temp; // Set uniqueTokenList equal to temp
-    }
-
-    string *uniqueTokenList = new string[tokenCount]; // Create a string array of size tokenCount to store unique tokens
-    int uniqueTokenCount = 0; // Variable to store amount of unique tokens
-    
-    for (int i = tokenCount; i > 0; i--) { // This loop goes from the amount of tokens down to 0
-        for (map<string, int>::iterator it = orderedTokenCount.begin(); it != orderedTokenCount.end(); ++it) { // This loop uses an iterator with my orderedTokenCount variable to print every token in order of their frequency
-            token = it->first; // Puts the first section (the string) into the token variable
-            if (it->second == i) { // Determines whether the second section (the int) is equivalent to i (token frequency)
-                outputFromProject5File += token + " "; // Print token
-                uniqueTokenList[uniqueTokenCount] = token; // Add unique token to unique token array
-                uniqueTokenCount++; // Increment uniqueTokenCount
-            }
+// The compressed input. A regular file (named on the command line, or redirected to stdin) is memory-mapped; anything
+// else (a pipe) is read into a buffer.
+class InputText {
+    public:
+        const char* data; // Input bytes
+        long long size; // Number of bytes
+        bool mapped; // data is a mapping of the file (otherwise a buffer of our own)
+        InputText(int fd); // Maps or reads everything fd has to offer
+        ~InputText(); // Unmaps or frees the bytes
+};
+InputText::InputText(int fd) { // Maps or reads everything fd has to offer
+    data = nullptr;
+    size = 0;
+    mapped = false;
+    struct stat info;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode)) {
+        size = info.st_size;
+        if (size == 0) {
+            return;
+        }
+        void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            data = (const char*)map;
+            mapped = true;
+            madvise(map, size, MADV_SEQUENTIAL);
+            return;
         }
     }
+    long long capacity = 1 << 20; // Room in the buffer
+    char* buffer = new char[capacity];
+    size = 0;
+    while (cin.read(buffer + size, capacity - size) || cin.gcount() > 0) { // Read everything, doubling the buffer as needed
+        size += cin.gcount();
+        if (size == capacity) {
+            char* bigger = new char[capacity * 2];
+            memcpy(bigger, buffer, size);
+            delete[] buffer;
+            buffer = bigger;
+            capacity *= 2;
+        }
+    }
+    data = buffer;
+}
+InputText::~InputText() { // Unmaps or frees the bytes
+    if (mapped) {
+        munmap((void*)data, size);
+    }
+    else {
+        delete[] data;
+    }
+}
 
-    outputFromProject5File += "\n";
-    outputFromProject5File += "**********\n";
+// The dictionary: every token's bytes back to back in one arena, and an offset table, so token r is
+// arena[offsets[r] ... offsets[r + 1]). Tokens are looked up by rank with no per-token allocation.
+class Dictionary {
+    public:
+        char* arena; // Bytes of every token in rank order
+        long long arenaSize; // Bytes used in arena
+        long long arenaCapacity; // Room in arena
+        long long* offsets; // Start of each token in arena, plus the end of the last one
+        int count; // Number of tokens
+        int capacity; // Room in offsets
+        Dictionary(); // Constructor
+        ~Dictionary(); // Destructor
+        void add(const char* token, int length); // Appends the token with the next rank
+};
+Dictionary::Dictionary() { // Constructor
+    arenaSize = 0;
+    arenaCapacity = 1 << 16;
+    arena = new char[arenaCapacity];
+    count = 0;
+    capacity = 1024;
+    offsets = new long long[capacity + 1];
+    offsets[0] = 0;
+}
+Dictionary::~Dictionary() { // Destructor
+    delete[] arena;
+    delete[] offsets;
+}
+void Dictionary::add(const char* token, int length) { // Appends the token with the next rank
+    if (arenaSize + length > arenaCapacity) { // Double the arena
+        while (arenaSize + length > arenaCapacity) {
+            arenaCapacity *= 2;
+        }
+        char* bigger = new char[arenaCapacity];
+        memcpy(bigger, arena, arenaSize);
+        delete[] arena;
+        arena = bigger;
+    }
+    if (count == capacity) { // Double the offset table
+        long long* bigger = new long long[2 * capacity + 1];
+        memcpy(bigger, offsets, (count + 1) * sizeof(long long));
+        delete[] offsets;
+        offsets = bigger;
+        capacity *= 2;
+    }
+    memcpy(arena + arenaSize, token, length);
+    arenaSize += length;
+    offsets[++count] = arenaSize;
+}
 
-    // ifstream inputFile(fileName); // Open up the previously identified input file
+// A growable buffer in memory. Each block is decoded into one of these on its own thread, then written out in order.
+class ByteBuffer {
+    public:
+        char* data; // Bytes so far
+        long long size; // Number of bytes in data
+        long long capacity; // Room in data
+        ByteBuffer(); // Constructor
+        ~ByteBuffer(); // Destructor
+        void put(const char* bytes, long long length); // Appends bytes
+};
+ByteBuffer::ByteBuffer() { // Constructor
+    size = 0;
+    capacity = 1 << 16;
+    data = new char[capacity];
+}
+ByteBuffer::~ByteBuffer() { // Destructor
+    delete[] data;
+}
+void ByteBuffer::put(const char* bytes, long long length) { // Appends bytes
+    if (size + length > capacity) { // Double the buffer
+        while (size + length > capacity) {
+            capacity *= 2;
+        }
+        char* bigger = new char[capacity];
+        memcpy(bigger, data, size);
+        delete[] data;
+        data = bigger;
+    }
+    memcpy(data + size, bytes, length);
+    size += length;
+}
+
+// Collects output in a large buffer and hands it to cout in big writes.
+class OutputBuffer {
+    public:
+        static const int SIZE = 1 << 20; // Bytes buffered before a write
+        char* data; // Buffered bytes
+        int used; // Bytes in data
+        OutputBuffer(); // Constructor
+        ~OutputBuffer(); // Destructor (flushes)
+        void put(const char* bytes, long long length); // Appends bytes
+        void flush(); // Writes out everything buffered
+};
+OutputBuffer::OutputBuffer() { // Constructor
+    data = new char[SIZE];
+    used = 0;
+}
+OutputBuffer::~OutputBuffer() { // Destructor
+    flush();
+    delete[] data;
+}
+void OutputBuffer::put(const char* bytes, long long length) { // Appends bytes
+    if (used + length > SIZE) {
+        flush();
+        if (length > SIZE) { // Too large to buffer
+            cout.write(bytes, length);
+            return;
+        }
+    }
+    memcpy(data + used, bytes, length);
+    used += length;
+}
+void OutputBuffer::flush() { // Writes out everything buffered
+    cout.write(data, used);
+    used = 0;
+}
 
-    for (int i = 0; i < tokenCount; i++) { // Go through entire inputFile and capture the tokens
-        // inputFile >> token; // Set token
-        token = tokenList[i]; // Read the tokens from tokenList into token
-        for (int j = 0; j < uniqueTokenCount; j++) { // Go through the entire uniqueTokenList to determine the index of the current token being read in
-            if (token == uniqueTokenList[j]) { // Determine whether or not the current token being read in is the jth token within the array
-                outputFromProject5File += to_string(j + 1); // The output starts from index 1, so increment all indeces by 1
-                break; // Break when the token is found within uniqueTokenList
+unsigned int crc32(unsigned int crc, const char* bytes, long long length) { // Continues a CRC-32 (IEEE, as zlib) over bytes
+    static unsigned int table[256]; // CRC of every byte value, built on first use
+    static bool ready = false;
+    if (!ready) {
+        for (unsigned int b = 0; b < 256; b++) {
+            unsigned int c = b;
+            for (int k = 0; k < 8; k++) {
+                c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
             }
+            table[b] = c;
         }
-        outputFromProject5File += " ";
+        ready = true;
+    }
+    crc = ~crc;
+    for (long long i = 0; i < length; i++) {
+        crc = table[(crc ^ (unsigned char)bytes[i]) & 0xff] ^ (crc >> 8);
     }
+    return ~crc;
+}
 
-    /*
-    DISCLAIMER!
-    Below is the decompression section of the program.
-    */
+bool isSeparator(unsigned char c) { // The bytes cin >> token skips
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
 
-    token = ""; // Variable for storing token input
-    uniqueTokenCount = 0; // Variable for storing number of unique tokens
-    uniqueTokenList = new string[uniqueTokenCount]; // Variable for storing unique tokens
+bool readVarint(const InputText& input, long long& pos, long long end, unsigned long long& value) { // Reads a LEB128 varint, false if truncated
+    value = 0;
+    for (int shift = 0; pos < end && shift < 64; shift += 7) {
+        unsigned char b = input.data[pos++];
+        value |= (unsigned long long)(b & 0x7f) << shift;
+        if (b < 0x80) {
+            return true;
+        }
+    }
+    return false;
+}
 
-    istringstream project5Output(outputFromProject5File); // Convert the string from project5 output into a stream
-    while (project5Output >> token && token != "**********") { // Read in all tokens until you get to the separator
-        uniqueTokenCount++; // Increment counter
-        string *temp = new string[uniqueTokenCount]; // Create temp array
-        for (int i = 0; i < uniqueTokenCount - 1; i++) { // Move everything from uniqueTokenList to temp array
-            temp[i] = uniqueTokenList[i];
+unsigned long long readFixed(const InputText& input, long long pos, int bytes) { // Reads a little-endian number of the given width
+    unsigned long long value = 0;
+    for (int k = 0; k < bytes; k++) {
+        value |= (unsigned long long)(unsigned char)input.data[pos + k] << (8 * k);
+    }
+    return value;
+}
+
+// Runs task(0) ... task(count - 1) at the same time, the last one on the calling thread, and waits for all of them.
+template <class Task>
+void runParallel(int count, const Task& task) {
+    thread* workers = new thread[count - 1];
+    for (int t = 0; t < count - 1; t++) {
+        workers[t] = thread(task, t);
+    }
+    task(count - 1);
+    for (int t = 0; t < count - 1; t++) {
+        workers[t].join();
+    }
+    delete[] workers;
+}
+
+// Decodes blocks a round of `threads` at a time, each into a buffer of its own, and writes them out in order.
+// decode(b, buffer) handles block b. When joined, it writes a space in front of every token, and the very first byte
+// written is dropped.
+template <class Decode>
+bool decodeBlocks(int blockCount, int threads, const Decode& decode, OutputBuffer& out, bool joined) {
+    ByteBuffer* decoded = new ByteBuffer[threads]; // Output of the blocks of one round
+    bool* ok = new bool[threads]; // Whether each block of the round decoded
+    bool first = true; // Nothing written yet
+    bool good = true;
+    for (int base = 0; base < blockCount && good; base += threads) {
+        int n = min(threads, blockCount - base);
+        runParallel(n, [&](int t) {
+            decoded[t].size = 0;
+            ok[t] = decode(base + t, decoded[t]);
+        });
+        for (int t = 0; t < n && good; t++) {
+            good = ok[t];
+            int skip = joined && first && decoded[t].size > 0 ? 1 : 0;
+            out.put(decoded[t].data + skip, decoded[t].size - skip);
+            first = first && decoded[t].size == 0;
         }
-        temp[uniqueTokenCount - 1] = token; // Add new token to temp array
-        delete[] uniqueTokenList; // Delete uniqueTokenList's contents
-        uniqueTokenList = temp; // Set uniqueTokenList equal to temp
     }
+    delete[] ok;
+    delete[] decoded;
+    return good;
+}
 
-    int index; // Var for storing input index
-    int indexCount = 0; // Var for storing number of indexes
-    int *indexList = new int[indexCount]; // Array for storing all indeces input
+// Binary container written by project5 --binary (see there): magic, counts, length-prefixed dictionary, ranks - 1 as
+// varints block after block, then the block index with its sync points, the inverted index, the offset of the block
+// index and a CRC-32, after the magic "P5B3". "P5S3" (project5 --lossless) is P5B3 plus a dictionary of separator runs,
+// and each block ends with the runs that are not plain.
+class Archive {
+    public:
+        const InputText& input; // The whole compressed file
+        unsigned long long uniqueCount; // Tokens in the dictionary
+        unsigned long long tokenCount; // Tokens in the text
+        Dictionary dictionary; // Token of every rank
+        bool lossless; // The file keeps separator runs
+        Dictionary separators; // Separator run of every rank (lossless only)
+        int blockCount; // Number of blocks
+        long long* blockStart; // Offset of each block in the file, plus the end of the last one
+        long long* firstToken; // Position in the text of the first token of each block, plus tokenCount
+        int syncInterval; // Tokens between sync points
+        long long* syncStart; // Where each block's sync points start in syncs, plus the end of the last block's
+        long long* syncs; // Offset in the file of every sync point, block after block
+        long long postingsAt; // Offset of the inverted index
+        Archive(const InputText& input); // Constructor
+        ~Archive(); // Destructor
+        bool open(); // Reads the header, the dictionary and the indexes, false (with a message) if they are damaged
+        bool verify() const; // Checks the CRC-32 of the whole file
+        bool decode(long long& at, long long count, ByteBuffer& out) const; // Decodes count tokens from offset at, each after a space
+        bool skip(long long& at, long long count) const; // Moves offset at past count tokens
+        int locate(long long token, long long& at, long long& before) const; // Block of a token, the nearest sync point at or before it and the tokens between
+        bool decodeExact(int b, long long from, long long to, bool leading, bool trailing, ByteBuffer& out) const; // Tokens from ... to - 1 of block b with the separator runs between them (lossless only)
+        bool readBlockList(long long& at, long long end, int* blocks, int& count) const; // Reads one rank's list of blocks from the inverted index into blocks (if not null)
+        void blocksUsing(unsigned long long rank, int*& blocks, int& count) const; // Blocks the rank occurs in, from the inverted index
+};
+Archive::Archive(const InputText& input) : input(input) { // Constructor
+    (*this).lossless = false;
+    (*this).uniqueCount = 0;
+    (*this).tokenCount = 0;
+    (*this).blockCount = 0;
+    (*this).blockStart = nullptr;
+    (*this).firstToken = nullptr;
+    (*this).syncInterval = 0;
+    (*this).syncStart = nullptr;
+    (*this).syncs = nullptr;
+    (*this).postingsAt = 0;
+}
+Archive::~Archive() { // Destructor
+    delete[] blockStart;
+    delete[] firstToken;
+    delete[] syncStart;
+    delete[] syncs;
+}
+bool Archive::open() { // Reads the header, the dictionary and the indexes
+    lossless = input.data[2] == 'S';
+    long long pos = 4, end = input.size - 12; // The index offset and the checksum come last
+    unsigned long long value;
+    if (pos > end || !readVarint(input, pos, end, uniqueCount) || !readVarint(input, pos, end, tokenCount)) {
+        cerr << "Truncated header." << endl;
+        return false;
+    }
+    for (unsigned long long r = 0; r < uniqueCount; r++) {
+        if (!readVarint(input, pos, end, value) || value > (unsigned long long)(end - pos)) {
+            cerr << "Truncated dictionary." << endl;
+            return false;
+        }
+        dictionary.add(input.data + pos, (int)value);
+        pos += value;
+    }
+    unsigned long long separatorCount = 0;
+    if (lossless && !readVarint(input, pos, end, separatorCount)) {
+        cerr << "Truncated dictionary." << endl;
+        return false;
+    }
+    for (unsigned long long r = 0; r < separatorCount; r++) {
+        if (!readVarint(input, pos, end, value) || value > (unsigned long long)(end - pos)) {
+            cerr << "Truncated dictionary." << endl;
+            return false;
+        }
+        separators.add(input.data + pos, (int)value);
+        pos += value;
+    }
+    unsigned long long indexOffset = readFixed(input, end, 8);
+    long long at = (long long)indexOffset;
+    bool ok = indexOffset >= (unsigned long long)pos && indexOffset <= (unsigned long long)end && readVarint(input, at, end, value) && value <= (unsigned long long)(end - at);
+    blockCount = ok ? (int)value : 0;
+    if (ok) {
+        ok = readVarint(input, at, end, value) && value > 0 && value < (1u << 30);
+        syncInterval = ok ? (int)value : 0;
+    }
+    blockStart = new long long[blockCount + 1];
+    firstToken = new long long[blockCount + 1];
+    syncStart = new long long[blockCount + 1];
+    long long syncCapacity = ok ? min((long long)(tokenCount / syncInterval), end - at) : 0; // Sync points can be no more than there are tokens, or index bytes
+    syncs = new long long[syncCapacity + 1];
+    blockStart[0] = pos;
+    firstToken[0] = 0;
+    syncStart[0] = 0;
+    for (int b = 0; b < blockCount && ok; b++) {
+        unsigned long long tokens, bytes;
+        ok = readVarint(input, at, end, tokens) && tokens <= tokenCount - firstToken[b] && readVarint(input, at, end, bytes) && bytes <= indexOffset - blockStart[b];
+        if (!ok) {
+            break;
+        }
+        blockStart[b + 1] = blockStart[b] + bytes;
+        firstToken[b + 1] = firstToken[b] + tokens;
+        syncStart[b + 1] = syncStart[b];
+        long long last = blockStart[b]; // Sync points are stored from the one before, the block start first
+        for (long long k = 1; k * syncInterval < (long long)tokens && ok; k++) {
+            ok = syncStart[b + 1] < syncCapacity && readVarint(input, at, end, value) && value <= (unsigned long long)(blockStart[b + 1] - last);
+            last += ok ? value : 0;
+            syncs[syncStart[b + 1]++] = last;
+        }
+    }
+    ok = ok && blockStart[blockCount] == (long long)indexOffset && firstToken[blockCount] == (long long)tokenCount;
+    if (ok) { // Walk the inverted index once so later lookups can trust it
+        postingsAt = at;
+        int count;
+        for (unsigned long long r = 0; r < uniqueCount && ok; r++) {
+            ok = readBlockList(at, end, nullptr, count);
+        }
+    }
+    if (!ok || at != end) {
+        cerr << "Bad block index." << endl;
+        return false;
+    }
+    return true;
+}
+bool Archive::verify() const { // Checks the CRC-32 of the whole file
+    if (input.size < 8 || crc32(0, input.data, input.size - 4) != readFixed(input, input.size - 4, 4)) {
+        cerr << "Checksum mismatch: the compressed file is damaged." << endl;
+        return false;
+    }
+    return true;
+}
+bool Archive::decode(long long& at, long long count, ByteBuffer& out) const { // Decodes count tokens from offset at, each after a space
+    unsigned long long rank;
+    for (long long i = 0; i < count; i++) {
+        if (!readVarint(input, at, blockStart[blockCount], rank) || rank >= uniqueCount) {
+            return false;
+        }
+        out.put(" ", 1);
+        out.put(dictionary.arena + dictionary.offsets[rank], dictionary.offsets[rank + 1] - dictionary.offsets[rank]);
+    }
+    return true;
+}
+bool Archive::skip(long long& at, long long count) const { // Moves offset at past count tokens
+    unsigned long long rank;
+    for (long long i = 0; i < count; i++) {
+        if (!readVarint(input, at, blockStart[blockCount], rank)) {
+            return false;
+        }
+    }
+    return true;
+}
+int Archive::locate(long long token, long long& at, long long& before) const { // Block of a token, the nearest sync point at or before it
+    int b = (int)(upper_bound(firstToken, firstToken + blockCount + 1, token) - firstToken) - 1; // Binary search of the block
+    long long k = (token - firstToken[b]) / syncInterval; // Sync points passed in the block
+    at = k > 0 ? syncs[syncStart[b] + k - 1] : blockStart[b];
+    before = token - firstToken[b] - k * syncInterval;
+    return b;
+}
+bool Archive::readBlockList(long long& at, long long end, int* blocks, int& count) const { // Reads one rank's list of blocks
+    unsigned long long value;
+    if (!readVarint(input, at, end, value) || value > (unsigned long long)blockCount) {
+        return false;
+    }
+    count = (int)value;
+    int bitmapBytes = (blockCount + 7) / 8;
+    if (count >= bitmapBytes) { // A bitmap, which must hold exactly count blocks
+        if (end - at < bitmapBytes) {
+            return false;
+        }
+        int found = 0;
+        for (int b = 0; b < bitmapBytes * 8; b++) {
+            if (input.data[at + b / 8] >> (b % 8) & 1) {
+                if (b >= blockCount || found == count) {
+                    return false;
+                }
+                if (blocks != nullptr) {
+                    blocks[found] = b;
+                }
+                found++;
+            }
+        }
+        at += bitmapBytes;
+        return found == count;
+    }
+    unsigned long long block = 0, delta;
+    for (int k = 0; k < count; k++) { // Differences, increasing and below blockCount
+        if (!readVarint(input, at, end, delta) || (k > 0 && delta == 0) || delta >= (unsigned long long)blockCount - block) {
+            return false;
+        }
+        block += delta;
+        if (blocks != nullptr) {
+            blocks[k] = (int)block;
+        }
+    }
+    return true;
+}
+bool Archive::decodeExact(int b, long long from, long long to, bool leading, bool trailing, ByteBuffer& out) const { // Tokens from ... to - 1 of block b with the runs between them
+    // Run i comes before token i, so the block is run 0, token 0, run 1, ..., token n - 1, run n. Only runs that are
+    // not plain are stored, after the ranks: reach them from the block's last sync point.
+    long long n = firstToken[b + 1] - firstToken[b];
+    long long lastSyncs = syncStart[b + 1] - syncStart[b];
+    long long at = lastSyncs > 0 ? syncs[syncStart[b + 1] - 1] : blockStart[b];
+    unsigned long long exceptionCount, gap, id;
+    if (!skip(at, n - lastSyncs * syncInterval) || !readVarint(input, at, blockStart[b + 1], exceptionCount)) {
+        return false;
+    }
+    long long nextRun = 0; // Index of the run after the last stored one read
+    long long stored = -1; // Index of the next stored run, -1 once there are none
+    unsigned long long storedId = 0; // Its separator rank
+    auto readStored = [&]() { // Reads the next stored run, false if it is damaged
+        if (exceptionCount == 0) {
+            stored = -1;
+            return true;
+        }
+        exceptionCount--;
+        if (!readVarint(input, at, blockStart[b + 1], gap) || !readVarint(input, at, blockStart[b + 1], id) || id >= (unsigned long long)separators.count || gap > (unsigned long long)(n - nextRun)) {
+            return false;
+        }
+        stored = nextRun + gap;
+        storedId = id;
+        nextRun = stored + 1;
+        return true;
+    };
+    if (!readStored()) {
+        return false;
+    }
+    while (stored >= 0 && stored < from) { // Runs before the range
+        if (!readStored()) {
+            return false;
+        }
+    }
+
+    long long tokenAt = blockStart[b], before = 0; // Where token from is
+    if (from < n) {
+        locate(firstToken[b] + from, tokenAt, before);
+    }
+    if (!skip(tokenAt, before)) {
+        return false;
+    }
+    for (long long i = from; i <= to; i++) {
+        if ((i > from || leading) && (i < to || trailing)) { // Run i, unless it is outside the range
+            if (stored == i) {
+                out.put(separators.arena + separators.offsets[storedId], separators.offsets[storedId + 1] - separators.offsets[storedId]);
+            }
+            else if (i > 0 && i < n) {
+                out.put(" ", 1);
+            }
+        }
+        if (stored == i && !readStored()) {
+            return false;
+        }
+        if (i < to) { // Token i
+            unsigned long long rank;
+            if (!readVarint(input, tokenAt, blockStart[b + 1], rank) || rank >= uniqueCount) {
+                return false;
+            }
+            out.put(dictionary.arena + dictionary.offsets[rank], dictionary.offsets[rank + 1] - dictionary.offsets[rank]);
+        }
+    }
+    while (stored >= 0) { // Runs after the range, read only to check the block ends where they do
+        if (!readStored()) {
+            return false;
+        }
+    }
+    return at == blockStart[b + 1];
+}
+void Archive::blocksUsing(unsigned long long rank, int*& blocks, int& count) const { // Blocks the rank occurs in
+    blocks = new int[blockCount];
+    long long at = postingsAt;
+    for (unsigned long long r = 0; r < rank; r++) { // Skip the lists before it (already checked by open)
+        readBlockList(at, input.size, nullptr, count);
+    }
+    readBlockList(at, input.size, blocks, count);
+}
 
-    while (project5Output >> index) { // Take in all indeces
-        indexCount++; // Increment indexCount
-        int *temp = new int[indexCount]; // Create temp array
-        for (int i = 0; i < indexCount - 1; i++) { // Move everything from indexList to temp array
-            temp[i] = indexList[i];
+
+// Text format: the dictionary tokens on one line, a "**********" line, then the 1-based ranks, all separated by
+// whitespace. Tokens never hold a newline, so the dictionary is the whole first line, even if "**********" is one of its
+// tokens. The ranks are cut into blocks of about BLOCK bytes at separators and decoded in parallel like binary blocks.
+const long long BLOCK = 4LL << 20;
+bool decodeText(const InputText& input, int threads, OutputBuffer& out) {
+    Dictionary dictionary;
+    const char* newline = (const char*)memchr(input.data, '\n', input.size);
+    long long lineEnd = newline ? newline - input.data : input.size;
+    long long pos = 0;
+    while (true) { // Read in all tokens of the first line
+        while (pos < lineEnd && isSeparator(input.data[pos])) {
+            pos++;
+        }
+        long long start = pos;
+        while (pos < lineEnd && !isSeparator(input.data[pos])) {
+            pos++;
         }
-        temp[indexCount - 1] = index - 1; // Add new index to temp array
-        delete[] indexList; // Delete indexList's contents
-        indexList = temp; // Set indexList equal to temp
+        if (pos == start) {
+            break;
+        }
+        dictionary.add(input.data + start, pos - start);
+    }
+    while (pos < input.size && isSeparator(input.data[pos])) { // The separator line comes next
+        pos++;
     }
+    if (!newline || input.size - pos < 10 || memcmp(input.data + pos, "**********", 10) != 0 || (pos + 10 < input.size && !isSeparator(input.data[pos + 10]))) {
+        cerr << "No ********** separator in the input." << endl;
+        return false;
+    }
+    pos += 10;
+
+    // Empty or whitespace-only text is written as the empty token, rank 1, which leaves no word in the dictionary
+    long long ranks = dictionary.count > 0 ? dictionary.count : 1;
 
-    for (int i = 0; i < indexCount; i++) { // Go through entire indexList array and use uniqueTokenList array to print the corresponding token
-        cout << uniqueTokenList[indexList[i]];
-        if (i < indexCount - 1) { // Determine whether we are at the end of the output
-            cout << " ";
+    int blockCount = (int)((input.size - pos + BLOCK - 1) / BLOCK);
+    long long* bounds = new long long[blockCount + 1]; // Block b is bounds[b] ... bounds[b + 1]
+    bounds[0] = pos;
+    for (int b = 1; b <= blockCount; b++) {
+        long long cut = max(bounds[b - 1], min(pos + b * BLOCK, input.size));
+        while (cut < input.size && !isSeparator(input.data[cut - 1])) { // Move the cut past the number it lands in
+            cut++;
+        }
+        bounds[b] = cut;
+    }
+    bool ok = decodeBlocks(blockCount, threads, [&](int b, ByteBuffer& buffer) { // Decode the ranks as they are parsed
+        long long at = bounds[b], end = bounds[b + 1];
+        while (true) {
+            while (at < end && isSeparator(input.data[at])) {
+                at++;
+            }
+            if (at == end) {
+                return true;
+            }
+            long long rank = 0;
+            long long start = at;
+            while (at < end && input.data[at] >= '0' && input.data[at] <= '9' && rank <= ranks) {
+                rank = rank * 10 + (input.data[at++] - '0');
+            }
+            if (at == start || rank < 1 || rank > ranks || (at < end && !isSeparator(input.data[at]))) {
+                return false;
+            }
+            if (dictionary.count == 0) { // The empty token writes nothing
+                continue;
+            }
+            buffer.put(" ", 1);
+            buffer.put(dictionary.arena + dictionary.offsets[rank - 1], dictionary.offsets[rank] - dictionary.offsets[rank - 1]);
         }
+    }, out, true);
+    if (!ok) {
+        cerr << "Bad rank in the token stream." << endl;
     }
+    delete[] bounds;
+    return ok;
+}
 
-    return 0;
+// project5_decompress [--threads N] [--at POSITION [--count N] | --grep TOKEN] [file]
+// Reads the compressed file directly (stdin by default), in either format, and writes the tokens separated by single
+// spaces, or the original text byte for byte from a lossless container. On a binary container two queries avoid
+// decoding all of it:
+//   --at POSITION    writes N tokens (1 by default) starting at the token at POSITION (0 based), decoding at most
+//                    a sync interval of tokens before them (with the original separators between them if lossless)
+//   --grep TOKEN     writes the position of every occurrence of TOKEN, one per line, decoding only the blocks the
+//                    inverted index lists for it
+// Queries read only the parts of the file they need, so they trust the checksum rather than verify it.
+int main(int argc, char* argv[]) {
+    ios::sync_with_stdio(false); // cin and cout are only used for large reads and writes
+    int threads = max(1, (int)thread::hardware_concurrency()); // Blocks decoded at the same time
+    long long atToken = -1; // --at position, -1 for none
+    long long count = 1; // --count
+    const char* grepToken = nullptr; // --grep token
+    int fd = 0; // Compressed file, stdin by default
+    for (int a = 1; a < argc; a++) {
+        string arg = argv[a];
+        if (arg == "--threads" && a + 1 < argc) {
+            threads = max(1, atoi(argv[++a]));
+        }
+        else if (arg == "--at" && a + 1 < argc) {
+            atToken = max(0LL, atoll(argv[++a]));
+        }
+        else if (arg == "--count" && a + 1 < argc) {
+            count = max(0LL, atoll(argv[++a]));
+        }
+        else if (arg == "--grep" && a + 1 < argc) {
+            grepToken = argv[++a];
+        }
+        else {
+            fd = open(argv[a], O_RDONLY);
+            if (fd < 0) {
+                cerr << "Cannot open " << argv[a] << endl;
+                return 1;
+            }
+        }
+    }
+    InputText input(fd);
+    OutputBuffer out;
+    bool binary = input.size >= 4 && (memcmp(input.data, "P5B3", 4) == 0 || memcmp(input.data, "P5S3", 4) == 0);
+    bool ok;
+    if (!binary) {
+        if (atToken >= 0 || grepToken != nullptr) {
+            cerr << "--at and --grep need a file written by project5 --binary." << endl;
+            ok = false;
+        }
+        else {
+            ok = decodeText(input, threads, out);
+        }
+    }
+    else {
+        Archive archive(input);
+        ok = atToken >= 0 || grepToken != nullptr || archive.verify(); // A full decode checks the file first
+        ok = ok && archive.open();
+        bool ranksOk = true; // Every rank decoded was in the dictionary, and every block held exactly its tokens
+        if (ok && atToken >= 0) { // Jump to the sync point before the token, skip to it, decode from there on
+            ByteBuffer decoded;
+            long long last = min(atToken + count, (long long)archive.tokenCount); // Just past the last token wanted
+            if (atToken < last) {
+                long long at, before;
+                int first = archive.locate(atToken, at, before);
+                if (archive.lossless) { // Block by block, with the separator runs between the tokens
+                    for (int b = first; b < archive.blockCount && archive.firstToken[b] < last && ranksOk; b++) {
+                        long long from = b == first ? atToken - archive.firstToken[b] : 0;
+                        long long to = min(last, archive.firstToken[b + 1]) - archive.firstToken[b];
+                        ranksOk = archive.decodeExact(b, from, to, b != first, last > archive.firstToken[b + 1], decoded);
+                    }
+                }
+                else {
+                    ranksOk = archive.skip(at, before) && archive.decode(at, last - atToken, decoded);
+                }
+            }
+            int skip = archive.lossless ? 0 : 1; // The space before the first token
+            if (ranksOk && decoded.size > 0) {
+                out.put(decoded.data + skip, decoded.size - skip);
+            }
+        }
+        else if (ok && grepToken != nullptr) { // Scan only the blocks that use the token's rank
+            long long length = strlen(grepToken);
+            long long rank = -1;
+            for (int r = 0; r < archive.dictionary.count && rank < 0; r++) {
+                if (archive.dictionary.offsets[r + 1] - archive.dictionary.offsets[r] == length && memcmp(archive.dictionary.arena + archive.dictionary.offsets[r], grepToken, length) == 0) {
+                    rank = r;
+                }
+            }
+            int* blocks = nullptr;
+            int blockCount = 0;
+            if (rank >= 0) {
+                archive.blocksUsing(rank, blocks, blockCount);
+            }
+            ranksOk = decodeBlocks(blockCount, threads, [&](int k, ByteBuffer& buffer) {
+                int b = blocks[k];
+                long long at = archive.blockStart[b];
+                unsigned long long value;
+                for (long long token = archive.firstToken[b]; token < archive.firstToken[b + 1]; token++) {
+                    if (!readVarint(input, at, archive.blockStart[b + 1], value)) {
+                        return false;
+                    }
+                    if (value == (unsigned long long)rank) {
+                        string line = to_string(token) + "\n";
+                        buffer.put(line.data(), line.size());
+                    }
+                }
+                return true;
+            }, out, false);
+            delete[] blocks;
+        }
+        else if (ok) { // Everything, block by block in parallel
+            ranksOk = decodeBlocks(archive.blockCount, threads, [&](int b, ByteBuffer& buffer) {
+                long long at = archive.blockStart[b];
+                if (archive.lossless) {
+                    return archive.decodeExact(b, 0, archive.firstToken[b + 1] - archive.firstToken[b], true, true, buffer);
+                }
+                return archive.decode(at, archive.firstToken[b + 1] - archive.firstToken[b], buffer) && at == archive.blockStart[b + 1]; // Each block holds exactly its tokens
+            }, out, !archive.lossless);
+        }
+        if (!ranksOk) {
+            cerr << "Bad rank in the token stream." << endl;
+            ok = false;
+        }
+    }
+    out.flush();
+    if (fd != 0) {
+        close(fd);
+    }
+    return ok ? 0 : 1;
 }
 
 /*